@@ -0,0 +1,247 @@
+/*
+ * Copyright (C) 2011-2014 Morwenn
+ *
+ * POLDER is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * POLDER is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program. If not,
+ * see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Throughput of the expression evaluator, in evaluations
+ * per second, for each of its evaluation modes:
+ *
+ *  - one-shot: evaluate() with the cache disabled, which
+ *    parses and runs the expression every time
+ *  - cached: evaluate() with the cache enabled
+ *  - compiled: an expression compiled once and called
+ *    with new values for its variables
+ *  - batch: a compiled expression evaluated over columns
+ *    of values, counted per row
+ *
+ * Usage: evaluate [seconds per measure]
+ */
+#include <cctype>
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <POLDER/evaluate.h>
+
+using namespace polder;
+
+
+namespace
+{
+    // Formulas over the variables x, y and z
+    const char* const short_formulas[] = {
+        "x + 1",
+        "x * y",
+        "x ** 2 + y ** 2",
+        "(x + y) / 2",
+        "x > 0 ? x : -x",
+        "max(x, y) - min(x, y)",
+        "sqrt(x * x + y * y)",
+        "x % 7 = 0 || y % 11 = 0",
+    };
+
+    const char* const long_formulas[] = {
+        // Compound interest with monthly contributions
+        "x * (1 + y / 12) ** (12 * z) + 100 * (((1 + y / 12) ** (12 * z) - 1) / (y / 12))",
+        // Piecewise tax bracket
+        "x <= 10000 ? 0 : x <= 40000 ? (x - 10000) * 0.2"
+        " : x <= 150000 ? 6000 + (x - 40000) * 0.4 : 50000 + (x - 150000) * 0.45",
+        // Polynomial in Horner form
+        "((((3.5 * x - 2.25) * x + 1.125) * x - 0.5) * x + 0.25) * x - 0.125",
+        // Distance between two points on a sphere
+        "2 * 6371 * asin(sqrt(sin((y - x) / 2) ** 2"
+        " + cos(x) * cos(y) * sin((z - x) / 2) ** 2))",
+        // Clamped and normalized score
+        "min(max((x - y) / (abs(z) + 1), -1), 1) * 50 + 50",
+        // Boolean rules
+        "(x > 0 && y > 0 && z > 0) || (x < 0 && y < 0) ^^ (z = 0) ? x * y * z : x + y + z",
+    };
+
+    auto values(std::size_t row)
+        -> std::vector<double>
+    {
+        return {
+            1.0 + static_cast<double>(row % 97) / 8.0,
+            0.05 + static_cast<double>(row % 13) / 100.0,
+            static_cast<double>(row % 31) - 10.0
+        };
+    }
+
+    // Formula where the variables are replaced by
+    // values, for the modes taking plain text
+    auto substitute(const std::string& formula, std::size_t row)
+        -> std::string
+    {
+        auto vals = values(row);
+        std::ostringstream res;
+        for (std::size_t i = 0 ; i < formula.size() ; ++i)
+        {
+            char c = formula[i];
+            bool is_name = (c == 'x' || c == 'y' || c == 'z')
+                && (i == 0 || not std::isalnum(formula[i-1]))
+                && (i+1 == formula.size() || not std::isalnum(formula[i+1]));
+            if (is_name)
+            {
+                res << '(' << vals[c - 'x'] << ')';
+            }
+            else
+            {
+                res << c;
+            }
+        }
+        return res.str();
+    }
+
+    /*
+     * Runs the function until the given time is spent
+     * and returns the number of evaluations per second;
+     * the function returns the number of evaluations it
+     * performed and a checksum of their results.
+     */
+    template<typename Function>
+    auto measure(double seconds, Function&& func)
+        -> double
+    {
+        using clock = std::chrono::steady_clock;
+        std::size_t nb_evaluations = 0;
+        double checksum = 0.0;
+
+        auto start = clock::now();
+        std::chrono::duration<double> elapsed;
+        do
+        {
+            nb_evaluations += func(checksum);
+            elapsed = clock::now() - start;
+        } while (elapsed.count() < seconds);
+
+        // Keeps the results alive
+        if (checksum == 42.4242)
+        {
+            std::cout << ' ';
+        }
+        return nb_evaluations / elapsed.count();
+    }
+
+    auto bench(const std::string& name, const std::vector<std::string>& formulas, double seconds)
+        -> void
+    {
+        const std::size_t nb_rows = 1024;
+
+        std::vector<std::vector<std::string>> texts;
+        std::vector<expression> compiled;
+        for (const auto& formula: formulas)
+        {
+            texts.emplace_back();
+            for (std::size_t row = 0 ; row < 16 ; ++row)
+            {
+                texts.back().push_back(substitute(formula, row));
+            }
+            compiled.push_back(compile(formula, { "x", "y", "z" }));
+        }
+
+        std::vector<std::vector<double>> columns(3, std::vector<double>(nb_rows));
+        for (std::size_t row = 0 ; row < nb_rows ; ++row)
+        {
+            auto vals = values(row);
+            for (std::size_t i = 0 ; i < 3 ; ++i)
+            {
+                columns[i][row] = vals[i];
+            }
+        }
+        const double* column_ptrs[] = { columns[0].data(), columns[1].data(), columns[2].data() };
+        std::vector<double> out(nb_rows);
+
+        auto textual = [&](double& checksum)
+        {
+            std::size_t count = 0;
+            for (const auto& variants: texts)
+            {
+                for (const auto& text: variants)
+                {
+                    checksum += evaluate(text);
+                    ++count;
+                }
+            }
+            return count;
+        };
+
+        set_expression_cache_capacity(0);
+        double one_shot = measure(seconds, textual);
+
+        set_expression_cache_capacity(4 * 1024 * 1024);
+        double cached = measure(seconds, textual);
+
+        double compiled_rate = measure(seconds, [&](double& checksum)
+        {
+            std::size_t count = 0;
+            for (const auto& expr: compiled)
+            {
+                for (std::size_t row = 0 ; row < nb_rows ; ++row)
+                {
+                    const double args[] = { columns[0][row], columns[1][row], columns[2][row] };
+                    checksum += expr(args);
+                }
+                count += nb_rows;
+            }
+            return count;
+        });
+
+        double batch = measure(seconds, [&](double& checksum)
+        {
+            std::size_t count = 0;
+            for (const auto& expr: compiled)
+            {
+                expr.evaluate_batch(column_ptrs, nb_rows, out.data());
+                checksum += out[nb_rows / 2];
+                count += nb_rows;
+            }
+            return count;
+        });
+
+        std::cout << std::left << std::setw(8) << name << std::right << std::fixed
+                  << std::setprecision(0)
+                  << std::setw(14) << one_shot
+                  << std::setw(14) << cached
+                  << std::setw(14) << compiled_rate
+                  << std::setw(14) << batch << '\n';
+    }
+}
+
+
+int main(int argc, char* argv[])
+{
+    double seconds = (argc > 1) ? std::atof(argv[1]) : 0.5;
+
+    std::vector<std::string> shorts(std::begin(short_formulas), std::end(short_formulas));
+    std::vector<std::string> longs(std::begin(long_formulas), std::end(long_formulas));
+
+    std::cout << "evaluations per second\n"
+              << std::left << std::setw(8) << "corpus" << std::right
+              << std::setw(14) << "one-shot"
+              << std::setw(14) << "cached"
+              << std::setw(14) << "compiled"
+              << std::setw(14) << "batch" << '\n';
+    bench("short", shorts, seconds);
+    bench("long", longs, seconds);
+
+    return 0;
+}
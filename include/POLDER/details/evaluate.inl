@@ -0,0 +1,651 @@
+/*
+ * Copyright (C) 2011-2014 Morwenn
+ *
+ * POLDER is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * POLDER is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program. If not,
+ * see <http://www.gnu.org/licenses/>.
+ */
+
+namespace meta
+{
+namespace details
+{
+    ////////////////////////////////////////////////////////////
+    // Lexer
+    ////////////////////////////////////////////////////////////
+
+    // Binary operators, in the same order
+    // as in the runtime evaluator
+    enum binary_operator: int
+    {
+        EQ, NE, GE, LE, AND, OR, XOR, POW, SPACE, LSHIFT, RSHIFT,
+        ADD, SUB, MUL, DIV, MOD, BAND, BOR, GT, LT, BXOR, IDIV,
+        NONE
+    };
+
+    constexpr unsigned int priorities[] = {
+        7, 7, 8, 8, 3, 1, 2, 12, 7, 9, 9,
+        10, 10, 11, 11, 11, 6, 4, 8, 8, 5, 11
+    };
+
+    struct token
+    {
+        int op;
+        std::size_t length;
+    };
+
+    // Value of a part of the expression and
+    // position of the first character after it
+    template<typename Number>
+    struct result
+    {
+        Number value;
+        std::size_t pos;
+    };
+
+    constexpr auto is_space(char c)
+        -> bool
+    {
+        return c == ' ' || c == '\t' || c == '\n'
+            || c == '\v' || c == '\f' || c == '\r';
+    }
+
+    constexpr auto is_digit(char c)
+        -> bool
+    {
+        return c >= '0' && c <= '9';
+    }
+
+    constexpr auto is_alpha(char c)
+        -> bool
+    {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+    }
+
+    constexpr auto skip_spaces(const char* expr, std::size_t pos)
+        -> std::size_t
+    {
+        return is_space(expr[pos]) ? skip_spaces(expr, pos+1) : pos;
+    }
+
+    // Binary operator starting at pos, if any
+    constexpr auto read_operator(const char* expr, std::size_t pos)
+        -> token
+    {
+        return (expr[pos] == '=') ? token{ EQ, 1 } :
+            (expr[pos] == '+') ? token{ ADD, 1 } :
+            (expr[pos] == '-') ? token{ SUB, 1 } :
+            (expr[pos] == '%') ? token{ MOD, 1 } :
+            (expr[pos] == '!') ?
+                (expr[pos+1] == '=') ? token{ NE, 2 } : token{ NONE, 0 } :
+            (expr[pos] == '*') ?
+                (expr[pos+1] == '*') ? token{ POW, 2 } : token{ MUL, 1 } :
+            (expr[pos] == '&') ?
+                (expr[pos+1] == '&') ? token{ AND, 2 } : token{ BAND, 1 } :
+            (expr[pos] == '|') ?
+                (expr[pos+1] == '|') ? token{ OR, 2 } : token{ BOR, 1 } :
+            (expr[pos] == '^') ?
+                (expr[pos+1] == '^') ? token{ XOR, 2 } : token{ BXOR, 1 } :
+            (expr[pos] == '/') ?
+                (expr[pos+1] == '/') ? token{ IDIV, 2 } : token{ DIV, 1 } :
+            (expr[pos] == '<') ?
+                (expr[pos+1] == '<') ? token{ LSHIFT, 2 } :
+                (expr[pos+1] == '>') ? token{ NE, 2 } :
+                (expr[pos+1] == '=') ?
+                    (expr[pos+2] == '>') ? token{ SPACE, 3 } : token{ LE, 2 } :
+                token{ LT, 1 } :
+            (expr[pos] == '>') ?
+                (expr[pos+1] == '>') ? token{ RSHIFT, 2 } :
+                (expr[pos+1] == '=') ? token{ GE, 2 } :
+                token{ GT, 1 } :
+            token{ NONE, 0 };
+    }
+
+    // Message for a character that can not start an operand
+    inline auto unexpected(char c)
+        -> std::string
+    {
+        return (c == '\0') ? "unexpected end of the expression" :
+            is_alpha(c) ? "variables and functions can not be evaluated at compile time" :
+            std::string("unexpected character '") + c + "' in the expression";
+    }
+
+    ////////////////////////////////////////////////////////////
+    // Literals
+    ////////////////////////////////////////////////////////////
+
+    // Exact up to 10^22
+    constexpr auto pow10(int exponent)
+        -> double
+    {
+        return (exponent == 0) ? 1.0 : 10.0 * pow10(exponent-1);
+    }
+
+    constexpr auto read_decimal(const char* expr, std::size_t pos,
+                                double mantissa, int nb_decimals, bool has_dot)
+        -> result<double>
+    {
+        return is_digit(expr[pos]) ?
+                read_decimal(expr, pos+1, mantissa * 10.0 + (expr[pos] - '0'),
+                             nb_decimals + has_dot, has_dot) :
+            (expr[pos] == '.') ?
+                has_dot ? throw evaluation_error("unexpected character '.' in the expression") :
+                read_decimal(expr, pos+1, mantissa, nb_decimals, true) :
+            result<double>{ mantissa / pow10(nb_decimals), pos };
+    }
+
+    constexpr auto read_integer(const char* expr, std::size_t pos, long long value)
+        -> result<long long>
+    {
+        return is_digit(expr[pos]) ?
+                (value > (std::numeric_limits<long long>::max() - (expr[pos] - '0')) / 10) ?
+                    throw evaluation_error("literal too big in an integer expression") :
+                read_integer(expr, pos+1, value * 10 + (expr[pos] - '0')) :
+            (expr[pos] == '.') ?
+                throw evaluation_error("non-integer literal in an integer expression") :
+            result<long long>{ value, pos };
+    }
+
+    // The last parameter selects the type of the literal
+    constexpr auto read_number(const char* expr, std::size_t pos, double)
+        -> result<double>
+    {
+        return read_decimal(expr, pos, 0.0, 0, false);
+    }
+
+    constexpr auto read_number(const char* expr, std::size_t pos, long long)
+        -> result<long long>
+    {
+        return read_integer(expr, pos, 0);
+    }
+
+    ////////////////////////////////////////////////////////////
+    // Operations
+    ////////////////////////////////////////////////////////////
+
+    /*
+     * The operations mirror the runtime evaluator: the integer
+     * operators on double give NaN when their operands do not
+     * fit in an int, and the operations on long long throw
+     * instead of overflowing.
+     */
+
+    constexpr double nan = std::numeric_limits<double>::quiet_NaN();
+    constexpr long long llong_min = std::numeric_limits<long long>::min();
+    constexpr long long llong_max = std::numeric_limits<long long>::max();
+
+    // Floating point numbers
+
+    constexpr auto fits_int(double a)
+        -> bool
+    {
+        return a > std::numeric_limits<int>::min() - 1.0
+            && a < std::numeric_limits<int>::max() + 1.0;
+    }
+
+    // Whether a // b and a % b are defined
+    constexpr auto integer_division(double a, double b)
+        -> bool
+    {
+        return fits_int(a) && fits_int(b)
+            && int(b) != 0
+            && not (int(a) == std::numeric_limits<int>::min() && int(b) == -1);
+    }
+
+    // Whether a << b and a >> b are defined
+    constexpr auto integer_shift(double a, double b)
+        -> bool
+    {
+        return fits_int(a) && fits_int(b) && int(b) >= 0 && int(b) < 32;
+    }
+
+    constexpr auto power(double base, long long exponent)
+        -> double
+    {
+        return (exponent < 0) ? 1.0 / power(base, -exponent) :
+            (exponent == 0) ? 1.0 :
+            (exponent == 1) ? base :
+            (exponent % 2) ? base * power(base * base, exponent / 2) :
+            power(base * base, exponent / 2);
+    }
+
+    constexpr auto power(double base, double exponent)
+        -> double
+    {
+        return (exponent == static_cast<long long>(exponent)) ?
+                power(base, static_cast<long long>(exponent)) :
+            throw evaluation_error("non-integer exponents can not be evaluated at compile time");
+    }
+
+    // Product of the integers in [first, last]
+    constexpr auto product(double res, int first, int last)
+        -> double
+    {
+        return (first > last) ? res : product(res * first, first + 1, last);
+    }
+
+    // Factorial of the natural numbers whose
+    // factorial is a finite double, NaN otherwise
+    constexpr auto factorial(double a)
+        -> double
+    {
+        return (not (a >= 0.0 && a <= 170.0) || a != int(a)) ? nan :
+            product(1.0, 2, int(a));
+    }
+
+    // Integers
+
+    constexpr auto checked_divisor(long long divisor)
+        -> long long
+    {
+        return (divisor != 0) ? divisor : throw division_by_zero();
+    }
+
+    inline auto overflow_error()
+        -> evaluation_error
+    {
+        return evaluation_error("integer overflow in an exact expression");
+    }
+
+    constexpr auto checked_add(long long a, long long b)
+        -> long long
+    {
+        return ((b > 0 && a > llong_max - b) || (b < 0 && a < llong_min - b)) ?
+                throw overflow_error() :
+            a + b;
+    }
+
+    constexpr auto checked_subtract(long long a, long long b)
+        -> long long
+    {
+        return ((b < 0 && a > llong_max + b) || (b > 0 && a < llong_min + b)) ?
+                throw overflow_error() :
+            a - b;
+    }
+
+    constexpr auto checked_multiply(long long a, long long b)
+        -> long long
+    {
+        return ((a > 0) ?
+                    (b > 0) ? a > llong_max / b : b < llong_min / a :
+                    (b > 0) ? a < llong_min / b : (a != 0 && b < llong_max / a)) ?
+                throw overflow_error() :
+            a * b;
+    }
+
+    constexpr auto checked_negate(long long a)
+        -> long long
+    {
+        return (a == llong_min) ? throw overflow_error() : -a;
+    }
+
+    constexpr auto checked_divide(long long a, long long b)
+        -> long long
+    {
+        return (checked_divisor(b) == -1 && a == llong_min) ?
+                throw overflow_error() :
+            a / b;
+    }
+
+    constexpr auto checked_modulo(long long a, long long b)
+        -> long long
+    {
+        return (checked_divisor(b) == -1 && a == llong_min) ?
+                throw overflow_error() :
+            a % b;
+    }
+
+    constexpr auto checked_shift_count(long long b)
+        -> long long
+    {
+        return (b < 0 || b > 63) ?
+                throw evaluation_error("shift count out of range: " + std::to_string(b)) :
+            b;
+    }
+
+    constexpr auto checked_left_shift(long long a, long long b)
+        -> long long
+    {
+        return (a > (llong_max >> checked_shift_count(b)) || a < (llong_min >> b)) ?
+                throw overflow_error() :
+            static_cast<long long>(static_cast<unsigned long long>(a) << b);
+    }
+
+    constexpr auto power(long long base, long long exponent)
+        -> long long
+    {
+        // Truncated result of 1 / base**-exponent
+        return (exponent < 0) ?
+                (base == 0) ? throw division_by_zero() :
+                (base == 1) ? 1 :
+                (base == -1) ? (exponent % 2 ? -1 : 1) :
+                0 :
+            (exponent == 0) ? 1 :
+            (exponent == 1) ? base :
+            (exponent % 2) ?
+                checked_multiply(base, power(checked_multiply(base, base), exponent / 2)) :
+            power(checked_multiply(base, base), exponent / 2);
+    }
+
+    constexpr auto product(long long res, long long first, long long last)
+        -> long long
+    {
+        return (first > last) ? res : product(res * first, first + 1, last);
+    }
+
+    constexpr auto factorial(long long a)
+        -> long long
+    {
+        // 21! does not fit in a long long
+        return (a < 0) ? throw evaluation_error("factorial of a negative number") :
+            (a > 20) ? throw overflow_error() :
+            product(1LL, 2LL, a);
+    }
+
+    constexpr auto apply(int op, double a, double b)
+        -> double
+    {
+        return (op == ADD) ? a + b :
+            (op == SUB) ? a - b :
+            (op == MUL) ? a * b :
+            (op == DIV) ? a / b :
+            (op == IDIV) ? integer_division(a, b) ? double(int(a) / int(b)) : nan :
+            (op == MOD) ? integer_division(a, b) ? double(int(a) % int(b)) : nan :
+            (op == BAND) ? fits_int(a) && fits_int(b) ? double(int(a) & int(b)) : nan :
+            (op == BXOR) ? fits_int(a) && fits_int(b) ? double(int(a) ^ int(b)) : nan :
+            (op == BOR) ? fits_int(a) && fits_int(b) ? double(int(a) | int(b)) : nan :
+            (op == LSHIFT) ?
+                // The bits shifted out are lost
+                integer_shift(a, b) ? double(int(unsigned(int(a)) << int(b))) : nan :
+            (op == RSHIFT) ? integer_shift(a, b) ? double(int(a) >> int(b)) : nan :
+            (op == LT) ? double(a < b) :
+            (op == GT) ? double(a > b) :
+            (op == EQ) ? double(a == b) :
+            (op == NE) ? double(a != b) :
+            (op == GE) ? double(a >= b) :
+            (op == LE) ? double(a <= b) :
+            (op == AND) ? double(a && b) :
+            (op == XOR) ? double((a && !b) || (b && !a)) :
+            (op == OR) ? double(a || b) :
+            (op == POW) ? power(a, b) :
+            (a < b) ? -1.0 : double(a != b);   // <=>
+    }
+
+    constexpr auto apply(int op, long long a, long long b)
+        -> long long
+    {
+        return (op == ADD) ? checked_add(a, b) :
+            (op == SUB) ? checked_subtract(a, b) :
+            (op == MUL) ? checked_multiply(a, b) :
+            (op == DIV || op == IDIV) ? checked_divide(a, b) :
+            (op == MOD) ? checked_modulo(a, b) :
+            (op == BAND) ? a & b :
+            (op == BXOR) ? a ^ b :
+            (op == BOR) ? a | b :
+            (op == LSHIFT) ? checked_left_shift(a, b) :
+            (op == RSHIFT) ? a >> checked_shift_count(b) :
+            (op == LT) ? a < b :
+            (op == GT) ? a > b :
+            (op == EQ) ? a == b :
+            (op == NE) ? a != b :
+            (op == GE) ? a >= b :
+            (op == LE) ? a <= b :
+            (op == AND) ? a && b :
+            (op == XOR) ? (a && !b) || (b && !a) :
+            (op == OR) ? a || b :
+            (op == POW) ? power(a, b) :
+            (a < b) ? -1 : (a != b);            // <=>
+    }
+
+    // Prefix operators: -, ! and ~
+    constexpr auto apply_prefix(char op, double a)
+        -> double
+    {
+        return (op == '-') ? -a :
+            (op == '!') ? double(!a) :
+            fits_int(a) ? double(~int(a)) : nan;
+    }
+
+    constexpr auto apply_prefix(char op, long long a)
+        -> long long
+    {
+        return (op == '-') ? checked_negate(a) :
+            (op == '!') ? !a :
+            ~a;
+    }
+
+    ////////////////////////////////////////////////////////////
+    // Parser
+    ////////////////////////////////////////////////////////////
+
+    /*
+     * The grammar is the same as the one of the runtime
+     * evaluator, parsed by recursive descent with one
+     * function per rule; the operands that the runtime
+     * evaluator would skip with && || and ?: are parsed
+     * but not computed, which is what the parameter live
+     * tells.
+     */
+
+    template<typename Number>
+    constexpr auto conditional(const char* expr, std::size_t pos, bool live)
+        -> result<Number>;
+
+    template<typename Number>
+    constexpr auto binary(const char* expr, std::size_t pos,
+                          unsigned int min_priority, bool live)
+        -> result<Number>;
+
+    template<typename Number>
+    constexpr auto prefix(const char* expr, std::size_t pos, bool live)
+        -> result<Number>;
+
+    // Conditional operator
+
+    template<typename Number>
+    constexpr auto conditional_else(const result<Number>& cond, const result<Number>& then,
+                                    const result<Number>& otherwise)
+        -> result<Number>
+    {
+        return { cond.value ? then.value : otherwise.value, otherwise.pos };
+    }
+
+    template<typename Number>
+    constexpr auto conditional_then(const char* expr, const result<Number>& cond,
+                                    const result<Number>& then, bool live)
+        -> result<Number>
+    {
+        return (expr[skip_spaces(expr, then.pos)] == ':') ?
+                conditional_else(cond, then,
+                                 conditional<Number>(expr, skip_spaces(expr, then.pos) + 1,
+                                                     live && not cond.value)) :
+            throw evaluation_error("missing ':' in conditional expression");
+    }
+
+    template<typename Number>
+    constexpr auto conditional_rest(const char* expr, const result<Number>& cond, bool live)
+        -> result<Number>
+    {
+        return (expr[skip_spaces(expr, cond.pos)] == '?') ?
+                conditional_then(expr, cond,
+                                 conditional<Number>(expr, skip_spaces(expr, cond.pos) + 1,
+                                                     live && cond.value),
+                                 live) :
+            cond;
+    }
+
+    template<typename Number>
+    constexpr auto conditional(const char* expr, std::size_t pos, bool live)
+        -> result<Number>
+    {
+        return conditional_rest(expr, binary<Number>(expr, pos, 0, live), live);
+    }
+
+    // Binary operators
+
+    // Whether the right operand of op has to be computed
+    template<typename Number>
+    constexpr auto is_operand_live(int op, Number lhs, bool live)
+        -> bool
+    {
+        return live
+            && not (op == AND && not lhs)
+            && not (op == OR && lhs);
+    }
+
+    template<typename Number>
+    constexpr auto combine(int op, const result<Number>& lhs,
+                           const result<Number>& rhs, bool live)
+        -> result<Number>
+    {
+        return { live ? apply(op, lhs.value, rhs.value) : lhs.value, rhs.pos };
+    }
+
+    template<typename Number>
+    constexpr auto binary_loop(const char* expr, const result<Number>& lhs,
+                               unsigned int min_priority, bool live)
+        -> result<Number>;
+
+    template<typename Number>
+    constexpr auto binary_step(const char* expr, const result<Number>& lhs,
+                               token tok, std::size_t pos,
+                               unsigned int min_priority, bool live)
+        -> result<Number>
+    {
+        return (tok.op != NONE && priorities[tok.op] >= min_priority) ?
+                binary_loop(expr,
+                            combine(tok.op, lhs,
+                                    binary<Number>(expr, pos + tok.length,
+                                                   priorities[tok.op] + 1,
+                                                   is_operand_live(tok.op, lhs.value, live)),
+                                    live),
+                            min_priority, live) :
+            lhs;
+    }
+
+    template<typename Number>
+    constexpr auto binary_loop(const char* expr, const result<Number>& lhs,
+                               unsigned int min_priority, bool live)
+        -> result<Number>
+    {
+        return binary_step(expr, lhs,
+                           read_operator(expr, skip_spaces(expr, lhs.pos)),
+                           skip_spaces(expr, lhs.pos),
+                           min_priority, live);
+    }
+
+    // Unary operators
+
+    template<typename Number>
+    constexpr auto postfix(const char* expr, const result<Number>& operand, bool live)
+        -> result<Number>
+    {
+        return (expr[skip_spaces(expr, operand.pos)] == '!'
+                && expr[skip_spaces(expr, operand.pos) + 1] != '=') ?
+                postfix(expr,
+                        result<Number>{ live ? factorial(operand.value) : operand.value,
+                                        skip_spaces(expr, operand.pos) + 1 },
+                        live) :
+            operand;
+    }
+
+    template<typename Number>
+    constexpr auto binary(const char* expr, std::size_t pos,
+                          unsigned int min_priority, bool live)
+        -> result<Number>
+    {
+        return binary_loop(expr, postfix(expr, prefix<Number>(expr, pos, live), live),
+                           min_priority, live);
+    }
+
+    template<typename Number>
+    constexpr auto apply_prefix(char op, const result<Number>& operand, bool live)
+        -> result<Number>
+    {
+        return { live ? apply_prefix(op, operand.value) : operand.value, operand.pos };
+    }
+
+    // Primary expressions
+
+    template<typename Number>
+    constexpr auto close_parenthesis(const char* expr, const result<Number>& inner)
+        -> result<Number>
+    {
+        return (expr[skip_spaces(expr, inner.pos)] == ')') ?
+                result<Number>{ inner.value, skip_spaces(expr, inner.pos) + 1 } :
+            throw evaluation_error((expr[skip_spaces(expr, inner.pos)] == '\0') ?
+                                   "mismatched parenthesis in the expression" :
+                                   "missing operator in the expression");
+    }
+
+    template<typename Number>
+    constexpr auto parenthesis(const char* expr, std::size_t pos, bool live)
+        -> result<Number>
+    {
+        return (expr[pos] == ')') ?
+                throw evaluation_error("empty parenthesis in the expression") :
+            close_parenthesis(expr, conditional<Number>(expr, pos, live));
+    }
+
+    template<typename Number>
+    constexpr auto primary(const char* expr, std::size_t pos, bool live)
+        -> result<Number>
+    {
+        return is_digit(expr[pos]) ? read_number(expr, pos, Number()) :
+            (expr[pos] == '(') ? parenthesis<Number>(expr, skip_spaces(expr, pos+1), live) :
+            throw evaluation_error(unexpected(expr[pos]));
+    }
+
+    template<typename Number>
+    constexpr auto prefix_at(const char* expr, std::size_t pos, bool live)
+        -> result<Number>
+    {
+        return (expr[pos] == '-' || expr[pos] == '~'
+                || (expr[pos] == '!' && expr[pos+1] != '=')) ?
+                apply_prefix(expr[pos], prefix<Number>(expr, pos+1, live), live) :
+            primary<Number>(expr, pos, live);
+    }
+
+    template<typename Number>
+    constexpr auto prefix(const char* expr, std::size_t pos, bool live)
+        -> result<Number>
+    {
+        return prefix_at<Number>(expr, skip_spaces(expr, pos), live);
+    }
+
+    // Whole expression
+
+    template<typename Number>
+    constexpr auto finish(const char* expr, const result<Number>& res)
+        -> Number
+    {
+        return (expr[skip_spaces(expr, res.pos)] == '\0') ? res.value :
+            throw evaluation_error(
+                (expr[skip_spaces(expr, res.pos)] == ')') ?
+                    "trying to close a non-opened parenthesis" :
+                (expr[skip_spaces(expr, res.pos)] == ':') ?
+                    "':' without matching '?' in the expression" :
+                    "missing operator in the expression"
+            );
+    }
+}
+
+    template<typename Number>
+    constexpr auto evaluate(const char* expr)
+        -> Number
+    {
+        return (expr[details::skip_spaces(expr, 0)] == '\0') ?
+                throw evaluation_error("empty expression") :
+            details::finish(expr, details::conditional<Number>(expr, 0, true));
+    }
+}
@@ -191,7 +191,7 @@ auto Matrix<T>::operator=(const Matrix<T>& other)
         _height = other._height;
         _width = other._width;
         _data = other._data;
-        _rows = std::vector<row>();
+        _rows.clear();
         for (size_type i = 0 ; i < height() ; ++i)
         {
             T* target = _data.data() + i * _width;
@@ -450,6 +450,27 @@ auto Matrix<T>::swap(Matrix<T>&& other)
     std::swap(*this, other);
 }
 
+template<typename T>
+auto Matrix<T>::resize(size_type height, size_type width)
+    -> void
+{
+    if (height == _height && width == _width)
+    {
+        return;
+    }
+
+    _height = height;
+    _width = width;
+    _data.resize(_height*_width);
+    // clear() keeps the capacity of the vector
+    _rows.clear();
+    for (size_type i = 0 ; i < _height ; ++i)
+    {
+        T* target = _data.data() + i * _width;
+        _rows.emplace_back(_width, target);
+    }
+}
+
 ////////////////////////////////////////////////////////////
 // NumPy-like functions
 ////////////////////////////////////////////////////////////
@@ -862,72 +883,70 @@ auto operator!=(const Matrix<T>& lhs, const Matrix<T>& rhs)
 ////////////////////////////////////////////////////////////
 
 template<typename T>
-auto operator+(Matrix<T> lhs, const Matrix<T>& rhs)
+auto operator+(const Matrix<T>& lhs, const Matrix<T>& rhs)
     -> Matrix<T>
 {
-    return lhs += rhs;
+    Matrix<T> res;
+    add_into(res, lhs, rhs);
+    return res;
 }
 
 template<typename T>
-auto operator-(Matrix<T> lhs, const Matrix<T>& rhs)
+auto operator-(const Matrix<T>& lhs, const Matrix<T>& rhs)
     -> Matrix<T>
 {
-    return lhs -= rhs;
+    Matrix<T> res;
+    subtract_into(res, lhs, rhs);
+    return res;
 }
 
 template<typename T>
-auto operator*(Matrix<T> lhs, const Matrix<T>& rhs)
+auto operator*(const Matrix<T>& lhs, const Matrix<T>& rhs)
     -> Matrix<T>
 {
-    POLDER_ASSERT(lhs.width() == rhs.height());
-    using size_type = typename Matrix<T>::size_type;
-
-    Matrix<T> res = Matrix<T>(lhs.height(), rhs.width());
-    for (size_type i = 0 ; i < lhs.height() ; ++i)
-    {
-        for (size_type j = 0 ; j < rhs.width() ; ++j)
-        {
-            T val{};
-            for (size_type k = 0 ; k < lhs.width() ; ++k)
-            {
-                val += lhs(i, k) * rhs(k, j);
-            }
-            res(i, j) = val;
-        }
-    }
+    Matrix<T> res;
+    multiply_into(res, lhs, rhs);
     return res;
 }
 
 template<typename T>
-auto operator/(Matrix<T> lhs, const Matrix<T>& rhs)
+auto operator/(const Matrix<T>& lhs, const Matrix<T>& rhs)
     -> Matrix<T>
 {
-    return lhs /= rhs;
+    Matrix<T> res;
+    divide_into(res, lhs, rhs);
+    return res;
 }
 
 ////////////////////////////////////////////////////////////
 // Matrix-value_type arithmetic operations (outside class)
 ////////////////////////////////////////////////////////////
 
+// The operand taken by value is the output
+// Matrix, its memory is reused
+
 template<typename T>
 auto operator*(Matrix<T> lhs, T rhs)
     -> Matrix<T>
 {
-    return lhs *= rhs;
+    multiply_into(lhs, lhs, rhs);
+    return lhs;
 }
 
 template<typename T>
 auto operator*(T lhs, Matrix<T> rhs)
     -> Matrix<T>
 {
-    return rhs *= lhs;
+    multiply_into(rhs, rhs, lhs);
+    return rhs;
 }
 
 template<typename T>
 auto operator/(Matrix<T> lhs, T rhs)
     -> Matrix<T>
 {
-    return lhs /= rhs;
+    divide_into(lhs, lhs, rhs);
+    return lhs;
 }
 
 ////////////////////////////////////////////////////////////
@@ -957,35 +976,13 @@ template<typename T>
 auto adjugate(const Matrix<T>& mat)
     -> Matrix<T>
 {
-    POLDER_ASSERT(mat.is_square());
-    using size_type = typename Matrix<T>::size_type;
-
-    Matrix<T> res(mat.height(), mat.width());
-
-    if (mat.height() == 2)
-    {
-        // Optimized formula for 2x2 Matrix
-        res(0, 0) = mat(1, 1);
-        res(0, 1) = -mat(0, 1);
-        res(1, 0) = -mat(1, 0);
-        res(1, 1) = mat(0, 0);
-    }
-    else // Generic formula
-    {
-        size_type degree = mat.height();
-        for (size_type i = 0 ; i < degree ; ++i)
-        {
-            for (size_type j = 0 ; j < degree ; ++j)
-            {
-                res(i, j) = cofactor(mat, {i, j});
-            }
-        }
-    }
+    Matrix<T> res;
+    adjugate_into(res, mat);
     return res;
 }
 
 template<typename T>
-auto cofactor(const Matrix<T> mat, std::pair<std::size_t, std::size_t> index)
+auto cofactor(const Matrix<T>& mat, std::pair<std::size_t, std::size_t> index)
     -> typename Matrix<T>::value_type
 {
     auto y = index.first;
@@ -1005,26 +1002,9 @@ template<typename T>
 auto inverse(const Matrix<T>& mat)
     -> Matrix<T>
 {
-    // Faster than mat.is_invertible
-    POLDER_ASSERT(mat.is_square());
-    const T det = determinant(mat);
-    POLDER_ASSERT(det != 0);
-
-    if (mat.height() == 2)
-    {
-        // Optimized formula for 2x2 Matrix
-        Matrix<T> res(2, 2);
-        res(0, 0) = mat(1, 1);
-        res(0, 1) = -mat(0, 1);
-        res(1, 0) = -mat(1, 0);
-        res(1, 1) = mat(0, 0);
-        return (res /= det);
-    }
-    else
-    {
-        // Generic formula
-        return transpose(adjugate(mat)) /= det;
-    }
+    Matrix<T> res;
+    inverse_into(res, mat);
+    return res;
 }
 
 template<typename T>
@@ -1052,14 +1032,188 @@ template<typename T>
 auto transpose(const Matrix<T>& mat)
     -> Matrix<T>
 {
+    Matrix<T> res;
+    transpose_into(res, mat);
+    return res;
+}
+
+////////////////////////////////////////////////////////////
+// Out-parameter Matrix-Matrix arithmetic operations
+////////////////////////////////////////////////////////////
+
+template<typename T>
+auto add_into(Matrix<T>& out, const Matrix<T>& lhs, const Matrix<T>& rhs)
+    -> Matrix<T>&
+{
+    POLDER_ASSERT(lhs.width() == rhs.width());
+    POLDER_ASSERT(lhs.height() == rhs.height());
+
+    out.resize(lhs.height(), lhs.width());
+    std::transform(lhs.fbegin(), lhs.fend(), rhs.fbegin(),
+                   out.fbegin(), std::plus<T>());
+    return out;
+}
+
+template<typename T>
+auto subtract_into(Matrix<T>& out, const Matrix<T>& lhs, const Matrix<T>& rhs)
+    -> Matrix<T>&
+{
+    POLDER_ASSERT(lhs.width() == rhs.width());
+    POLDER_ASSERT(lhs.height() == rhs.height());
+
+    out.resize(lhs.height(), lhs.width());
+    std::transform(lhs.fbegin(), lhs.fend(), rhs.fbegin(),
+                   out.fbegin(), std::minus<T>());
+    return out;
+}
+
+template<typename T>
+auto multiply_into(Matrix<T>& out, const Matrix<T>& lhs, const Matrix<T>& rhs)
+    -> Matrix<T>&
+{
+    POLDER_ASSERT(lhs.width() == rhs.height());
+    POLDER_ASSERT(&out != &lhs && &out != &rhs);
+    using size_type = typename Matrix<T>::size_type;
+
+    out.resize(lhs.height(), rhs.width());
+    for (size_type i = 0 ; i < lhs.height() ; ++i)
+    {
+        for (size_type j = 0 ; j < rhs.width() ; ++j)
+        {
+            T val{};
+            for (size_type k = 0 ; k < lhs.width() ; ++k)
+            {
+                val += lhs(i, k) * rhs(k, j);
+            }
+            out(i, j) = val;
+        }
+    }
+    return out;
+}
+
+template<typename T>
+auto divide_into(Matrix<T>& out, const Matrix<T>& lhs, const Matrix<T>& rhs)
+    -> Matrix<T>&
+{
+    POLDER_ASSERT(&out != &lhs && &out != &rhs);
+
+    Matrix<T> inv;
+    inverse_into(inv, rhs);
+    return multiply_into(out, lhs, inv);
+}
+
+////////////////////////////////////////////////////////////
+// Out-parameter Matrix-value_type arithmetic operations
+////////////////////////////////////////////////////////////
+
+template<typename T>
+auto multiply_into(Matrix<T>& out, const Matrix<T>& mat, T value)
+    -> Matrix<T>&
+{
+    out.resize(mat.height(), mat.width());
+    std::transform(mat.fbegin(), mat.fend(), out.fbegin(),
+                   [&](const T& val) { return val * value; });
+    return out;
+}
+
+template<typename T>
+auto divide_into(Matrix<T>& out, const Matrix<T>& mat, T value)
+    -> Matrix<T>&
+{
+    out.resize(mat.height(), mat.width());
+    std::transform(mat.fbegin(), mat.fend(), out.fbegin(),
+                   [&](const T& val) { return val / value; });
+    return out;
+}
+
+////////////////////////////////////////////////////////////
+// Out-parameter miscellaneous functions
+////////////////////////////////////////////////////////////
+
+template<typename T>
+auto adjugate_into(Matrix<T>& out, const Matrix<T>& mat)
+    -> Matrix<T>&
+{
+    POLDER_ASSERT(mat.is_square());
+    POLDER_ASSERT(&out != &mat);
     using size_type = typename Matrix<T>::size_type;
-    Matrix<T> res = Matrix<T>(mat.width(), mat.height());
+
+    out.resize(mat.height(), mat.width());
+
+    if (mat.height() == 2)
+    {
+        // Optimized formula for 2x2 Matrix
+        out(0, 0) = mat(1, 1);
+        out(0, 1) = -mat(0, 1);
+        out(1, 0) = -mat(1, 0);
+        out(1, 1) = mat(0, 0);
+    }
+    else // Generic formula
+    {
+        size_type degree = mat.height();
+        for (size_type i = 0 ; i < degree ; ++i)
+        {
+            for (size_type j = 0 ; j < degree ; ++j)
+            {
+                out(i, j) = cofactor(mat, {i, j});
+            }
+        }
+    }
+    return out;
+}
+
+template<typename T>
+auto inverse_into(Matrix<T>& out, const Matrix<T>& mat)
+    -> Matrix<T>&
+{
+    // Faster than mat.is_invertible
+    POLDER_ASSERT(mat.is_square());
+    POLDER_ASSERT(&out != &mat);
+    using size_type = typename Matrix<T>::size_type;
+
+    const T det = determinant(mat);
+    POLDER_ASSERT(det != 0);
+
+    out.resize(mat.height(), mat.width());
+
+    if (mat.height() == 2)
+    {
+        // Optimized formula for 2x2 Matrix
+        out(0, 0) = mat(1, 1);
+        out(0, 1) = -mat(0, 1);
+        out(1, 0) = -mat(1, 0);
+        out(1, 1) = mat(0, 0);
+    }
+    else
+    {
+        // Generic formula: transposed matrix of
+        // cofactors, written directly in place
+        size_type degree = mat.height();
+        for (size_type i = 0 ; i < degree ; ++i)
+        {
+            for (size_type j = 0 ; j < degree ; ++j)
+            {
+                out(j, i) = cofactor(mat, {i, j});
+            }
+        }
+    }
+    return out /= det;
+}
+
+template<typename T>
+auto transpose_into(Matrix<T>& out, const Matrix<T>& mat)
+    -> Matrix<T>&
+{
+    POLDER_ASSERT(&out != &mat);
+    using size_type = typename Matrix<T>::size_type;
+
+    out.resize(mat.width(), mat.height());
     for (size_type i = 0 ; i < mat.height() ; ++i)
     {
         for (size_type j = 0 ; j < mat.width() ; ++j)
         {
-            res[j][i] = mat[i][j];
+            out(j, i) = mat(i, j);
         }
     }
-    return res;
+    return out;
 }
@@ -21,19 +21,213 @@
 ////////////////////////////////////////////////////////////
 // Headers
 ////////////////////////////////////////////////////////////
+#include <cstddef>
 #include <exception>
+#include <initializer_list>
+#include <limits>
 #include <string>
+#include <vector>
+#include <POLDER/exceptions.h>
 #include <POLDER/details/config.h>
 
 namespace polder
 {
+    namespace details
+    {
+        /**
+         * @brief Instruction of a compiled expression
+         *
+         * The meaning of the operand depends on the
+         * operation code, which is private to the
+         * evaluation module.
+         */
+        struct instruction
+        {
+            int op;                 /**< Operation code */
+            union
+            {
+                double value;       /**< Literal value */
+                std::size_t index;  /**< Variable slot, jump target... */
+                double (*unary_function)(double);           /**< Built-in function */
+                double (*binary_function)(double, double);  /**< Built-in function */
+            };
+        };
+
+        /**
+         * @brief Code of a compiled expression
+         */
+        struct program
+        {
+            std::vector<instruction> code;      /**< Instructions */
+            std::size_t stack_size = 0;         /**< Values stack size */
+            std::size_t nb_temporaries = 0;     /**< Shared results */
+        };
+    }
+
+    ////////////////////////////////////////////////////////////
+    // Compiled expressions
+    ////////////////////////////////////////////////////////////
+
+    /**
+     * @brief Compiled mathematical/logical expression
+     *
+     * An expression is parsed once into a flat array of
+     * instructions in reverse Polish notation. Evaluating
+     * it is then a simple loop over these instructions,
+     * without any parsing or memory allocation.
+     *
+     * The identifiers found in the expression are variables.
+     * Each of them is given a slot at compile time, and the
+     * expression is then evaluated against an array of
+     * values where the value of each variable is found at
+     * the index of its slot.
+     *
+     * A default-constructed expression is empty and can not
+     * be evaluated: it throws evaluation_error.
+     *
+     * @see compile
+     */
+    class POLDER_API expression
+    {
+        public:
+
+            /**
+             * @brief Evaluates an expression without variables
+             * @return Result of the expression
+             */
+            auto operator()() const
+                -> double;
+
+            /**
+             * @brief Evaluates the expression
+             *
+             * @param args Values of the variables, by slot
+             * @return Result of the expression
+             */
+            auto operator()(const double* args) const
+                -> double;
+            auto operator()(std::initializer_list<double> args) const
+                -> double;
+
+            /**
+             * @brief Evaluates the expression over columns of values
+             *
+             * The expression is evaluated for every row of the
+             * columns. The rows are processed by blocks, and every
+             * instruction is applied to a whole block at once,
+             * which amortizes the cost of the dispatch and allows
+             * the compiler to vectorize the operations. The
+             * operators &&, || and ?: do not short-circuit in
+             * this mode; all of their operands are evaluated.
+             *
+             * @param columns Values of the variables, by slot; each
+             *        column holds the values of a variable for all rows
+             * @param size Number of rows
+             * @param out Result of the expression for every row
+             */
+            auto evaluate_batch(const double* const* columns, std::size_t size, double* out) const
+                -> void;
+
+            /**
+             * @brief Names of the variables, by slot
+             * @return Variables of the expression
+             */
+            auto variables() const
+                -> const std::vector<std::string>&;
+
+            /**
+             * @brief Slot of a given variable
+             *
+             * @param name Name of the variable
+             * @return Index of the variable's value
+             */
+            auto slot(const std::string& name) const
+                -> std::size_t;
+
+            /**
+             * @brief Approximate memory used by the expression
+             * @return Number of bytes
+             */
+            auto memory_usage() const
+                -> std::size_t;
+
+        private:
+
+            friend auto compile(const std::string& expr)
+                -> expression;
+            friend auto compile(const std::string& expr,
+                                const std::vector<std::string>& variables)
+                -> expression;
+
+            details::program _program;          /**< Code with short-circuits */
+            details::program _batch_program;    /**< Branch-free code, if different */
+            std::vector<std::string> _variables; /**< Variables names */
+    };
+
     ////////////////////////////////////////////////////////////
     // Functions
     ////////////////////////////////////////////////////////////
 
+    /**
+     * @brief Compiles a mathematical/logical expression
+     *
+     * The returned expression can be evaluated as many
+     * times as needed without having to parse it again.
+     * The variables are given slots in order of first
+     * appearance in the expression.
+     *
+     * The expression is optimized once compiled: constant
+     * subexpressions are computed at compile time, some
+     * trivial operations such as x*1 are removed, and the
+     * subexpressions that appear several times are only
+     * computed once per evaluation. The operators &&, ||
+     * and ?: only evaluate the operands they need.
+     *
+     * @param expr Expression to compile
+     * @return Compiled expression
+     */
+    POLDER_API
+    auto compile(const std::string& expr)
+        -> expression;
+
+    /**
+     * @brief Compiles a mathematical/logical expression
+     *
+     * The slot of each variable is its index in the given
+     * list of variables. Any other identifier found in the
+     * expression is an error. An empty list of variables is
+     * the same as no list at all.
+     *
+     * @param expr Expression to compile
+     * @param variables Names of the allowed variables
+     * @return Compiled expression
+     */
+    POLDER_API
+    auto compile(const std::string& expr, const std::vector<std::string>& variables)
+        -> expression;
+
     /**
      * @brief Evaluates a mathematical/logical expression
      *
+     * The expression shall not contain any variable. It
+     * can call the usual math functions: abs, sqrt, cbrt,
+     * exp, log, log2, log10, sin, cos, tan, asin, acos,
+     * atan, sinh, cosh, tanh, floor, ceil, round, trunc,
+     * sign, degrees, radians, sinc, and min, max, pow,
+     * atan2, hypot and fmod which take two arguments.
+     *
+     * The integer operators //, %, &, |, ^, ~, << and >>
+     * work on the operands truncated to int; their result
+     * is NaN when an operand does not fit in an int, when
+     * the divisor is zero or when the shift count is not in
+     * [0, 31]. The factorial is NaN for the numbers that are
+     * not natural or whose factorial is not a finite double.
+     *
+     * The compiled expressions are kept in a process-wide
+     * cache, so evaluating the same expression again does
+     * not parse it again. The cache is safe to use from
+     * several threads at once.
+     *
      * @param expr Expression to evaluate
      * @return Result of the expression
      */
@@ -41,6 +235,125 @@ namespace polder
     auto evaluate(const std::string& expr)
         -> double;
 
+    template<typename T>
+    struct rational;
+
+    /**
+     * @brief Evaluates an expression with a given kind of numbers
+     *
+     * The supported types are double, which is the same as
+     * the non-template evaluate, long long and
+     * rational<long long>. The two latter compute the exact
+     * result: the literals are read as integers or fractions,
+     * and the operators work directly on them without any
+     * conversion to floating point numbers. With long long,
+     * the operator / is an integer division. The integer
+     * operators such as % or & can only be applied to whole
+     * fractions. The built-in functions are not available.
+     *
+     * @param expr Expression to evaluate
+     * @return Result of the expression
+     * @throw division_by_zero For an exact division by zero
+     * @throw evaluation_error If an intermediate result does
+     *        not fit in a long long
+     */
+    template<typename Number>
+    auto evaluate(const std::string& expr)
+        -> Number;
+
+    template<>
+    POLDER_API
+    auto evaluate<double>(const std::string& expr)
+        -> double;
+
+    template<>
+    POLDER_API
+    auto evaluate<long long>(const std::string& expr)
+        -> long long;
+
+    template<>
+    POLDER_API
+    auto evaluate<rational<long long>>(const std::string& expr)
+        -> rational<long long>;
+
+    namespace meta
+    {
+        /**
+         * @brief Evaluates a constant expression at compile time
+         *
+         * The grammar is the same as the one of evaluate, but
+         * variables and built-in functions are not available,
+         * and ** only accepts integer exponents. Number can be
+         * double or long long, in which case / is an integer
+         * division. When the expression is used in a constant
+         * expression, any error is reported at compile time:
+         *
+         * constexpr double val = meta::evaluate("(1 + 2) ** 3 / 4");
+         *
+         * The literals are exact with at most 15 significant
+         * digits and 22 decimals. The operator ** is computed
+         * by repeated multiplications: its result may differ
+         * from the runtime evaluator in the last bits. The
+         * other operators give the same results as evaluate:
+         * // and % give NaN instead of dividing by zero, and
+         * with long long, the overflows are errors.
+         *
+         * @param expr Expression to evaluate
+         * @return Result of the expression
+         * @throw evaluation_error If the expression is invalid
+         */
+        template<typename Number=double>
+        constexpr auto evaluate(const char* expr)
+            -> Number;
+    }
+
+    ////////////////////////////////////////////////////////////
+    // Cache of compiled expressions
+    ////////////////////////////////////////////////////////////
+
+    /**
+     * @brief Statistics of the cache used by evaluate
+     */
+    struct cache_statistics
+    {
+        std::size_t hits = 0;       /**< Expressions found in the cache */
+        std::size_t misses = 0;     /**< Expressions not found in the cache */
+        std::size_t evictions = 0;  /**< Expressions removed to make room */
+        std::size_t entries = 0;    /**< Expressions in the cache */
+        std::size_t memory = 0;     /**< Approximate memory used, in bytes */
+        std::size_t capacity = 0;   /**< Maximal memory used, in bytes */
+    };
+
+    /**
+     * @brief Statistics of the cache of compiled expressions
+     * @return Current statistics
+     */
+    POLDER_API
+    auto expression_cache_statistics()
+        -> cache_statistics;
+
+    /**
+     * @brief Changes the memory bound of the cache
+     *
+     * The least recently used expressions are removed from
+     * the cache when it uses more memory than its capacity.
+     * A capacity of 0 disables the cache.
+     *
+     * @param bytes New capacity, in bytes
+     */
+    POLDER_API
+    auto set_expression_cache_capacity(std::size_t bytes)
+        -> void;
+
+    /**
+     * @brief Removes every expression from the cache
+     *
+     * The statistics are reset too.
+     */
+    POLDER_API
+    auto clear_expression_cache()
+        -> void;
+
     ////////////////////////////////////////////////////////////
     // Errors/Exceptions handling
     ////////////////////////////////////////////////////////////
@@ -68,6 +381,8 @@ namespace polder
         private:
             std::string msg; /**< Error message */
     };
+
+    #include "details/evaluate.inl"
 }
 
 #endif // _POLDER_EVALUATE_H
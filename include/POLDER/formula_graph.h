@@ -0,0 +1,167 @@
+/*
+ * Copyright (C) 2011-2014 Morwenn
+ *
+ * POLDER is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * POLDER is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program. If not,
+ * see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _POLDER_FORMULA_GRAPH_H
+#define _POLDER_FORMULA_GRAPH_H
+
+////////////////////////////////////////////////////////////
+// Headers
+////////////////////////////////////////////////////////////
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <POLDER/evaluate.h>
+#include <POLDER/details/config.h>
+
+namespace polder
+{
+    /**
+     * @brief Set of interdependent named formulas
+     *
+     * Every name is either an input, whose value is set
+     * directly, or a formula, whose value is computed from
+     * an expression whose variables are other names, the
+     * way cells work in a spreadsheet:
+     *
+     * formula_graph graph;
+     * graph.set("a", 2.0);
+     * graph.set("b", 3.0);
+     * graph.define("c", "a * b");
+     * graph.define("d", "c + 1");
+     * graph.value("d");    // 7.0
+     * graph.set("a", 4.0); // Only c and d are recomputed
+     *
+     * When a name changes, the formulas depending on it are
+     * marked dirty and only those are recomputed, in an
+     * order where every formula is computed after the ones
+     * it depends on. Dirty formulas that do not depend on
+     * each other at all can be recomputed by several threads.
+     *
+     * The names used in a formula but never set nor defined
+     * are inputs whose value is NaN.
+     */
+    class POLDER_API formula_graph
+    {
+        public:
+
+            /**
+             * @brief Creates an empty graph
+             *
+             * @param nb_threads Maximal number of threads used to
+             *        recompute the formulas; 0 means as many as
+             *        the hardware supports
+             */
+            explicit formula_graph(std::size_t nb_threads=1);
+
+            /**
+             * @brief Defines or redefines a formula
+             *
+             * @param name Name of the formula
+             * @param expr Expression computing its value
+             * @throw evaluation_error If the expression is invalid
+             *        or if the formula would depend on itself
+             */
+            auto define(const std::string& name, const std::string& expr)
+                -> void;
+
+            /**
+             * @brief Sets the value of an input
+             *
+             * If the name was a formula, it becomes an input.
+             *
+             * @param name Name of the input
+             * @param value New value of the input
+             */
+            auto set(const std::string& name, double value)
+                -> void;
+
+            /**
+             * @brief Value of a formula or of an input
+             *
+             * The dirty formulas are recomputed first.
+             *
+             * @param name Name of the formula or input
+             * @return Up-to-date value
+             */
+            auto value(const std::string& name)
+                -> double;
+
+            /**
+             * @brief Whether the name is known
+             * @param name Name of a formula or input
+             */
+            auto contains(const std::string& name) const
+                -> bool;
+
+            /**
+             * @brief Recomputes every dirty formula
+             */
+            auto recalculate()
+                -> void;
+
+        private:
+
+            struct node
+            {
+                std::string name;
+                bool is_formula = false;
+                expression formula;                     // Valid if is_formula
+                std::vector<std::size_t> dependencies;  // Node of each slot
+                std::vector<std::size_t> dependents;
+                double value;
+                bool dirty = false;
+                bool queued = false;    // In the list of dirty nodes
+
+                // Used while recomputing the formulas
+                std::size_t pending;    // Dirty dependencies not computed yet
+                std::size_t parent;     // Union-find of the dirty groups
+            };
+
+            // Node of the given name, created as
+            // an input if it does not exist yet
+            auto find_or_create(const std::string& name)
+                -> std::size_t;
+
+            // Whether the node to depends, directly or
+            // not, on the node from
+            auto reaches(std::size_t from, std::size_t to) const
+                -> bool;
+
+            auto set_dependencies(std::size_t id, std::vector<std::size_t>&& dependencies)
+                -> void;
+
+            // Marks a node and everything that
+            // depends on it as dirty
+            auto mark_dirty(std::size_t id)
+                -> void;
+
+            // Empties the list of dirty nodes
+            auto clear_dirty()
+                -> void;
+
+            auto compute(std::size_t id, std::vector<double>& args)
+                -> void;
+
+            std::vector<node> _nodes;
+            std::unordered_map<std::string, std::size_t> _index;
+            std::vector<std::size_t> _dirty;
+            std::size_t _nb_threads;
+    };
+}
+
+#endif // _POLDER_FORMULA_GRAPH_H
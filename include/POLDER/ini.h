@@ -21,9 +21,23 @@
 ////////////////////////////////////////////////////////////
 // Headers
 ////////////////////////////////////////////////////////////
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
 #include <exception>
 #include <fstream>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <ostream>
 #include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 #include <POLDER/details/config.h>
 
 
@@ -42,6 +56,7 @@ namespace polder
 */
 namespace ini
 {
+    class POLDER_API Error;
 
     /**
 * @brief Dialect for parsing an INI file.
@@ -85,6 +100,1023 @@ namespace ini
             std::string _data;
     };
 
+    /**
+* @brief Non-owning reference to a sequence of characters
+*/
+    class POLDER_API StringView
+    {
+        public:
+
+            constexpr StringView() noexcept:
+                _data(nullptr),
+                _size(0)
+            {}
+
+            constexpr StringView(const char* data, std::size_t size) noexcept:
+                _data(data),
+                _size(size)
+            {}
+
+            StringView(const char* str);
+            StringView(const std::string& str);
+
+            constexpr auto data() const noexcept
+                -> const char*
+            {
+                return _data;
+            }
+
+            constexpr auto size() const noexcept
+                -> std::size_t
+            {
+                return _size;
+            }
+
+            constexpr auto empty() const noexcept
+                -> bool
+            {
+                return _size == 0;
+            }
+
+            constexpr auto begin() const noexcept
+                -> const char*
+            {
+                return _data;
+            }
+
+            constexpr auto end() const noexcept
+                -> const char*
+            {
+                return _data + _size;
+            }
+
+            constexpr auto operator[](std::size_t pos) const noexcept
+                -> char
+            {
+                return _data[pos];
+            }
+
+            explicit operator std::string() const;
+
+        private:
+
+            const char* _data;
+            std::size_t _size;
+    };
+
+    POLDER_API
+    auto operator==(StringView lhs, StringView rhs) noexcept
+        -> bool;
+    POLDER_API
+    auto operator!=(StringView lhs, StringView rhs) noexcept
+        -> bool;
+    POLDER_API
+    auto operator<<(std::ostream& stream, StringView view)
+        -> std::ostream&;
+
+    /**
+* @brief Parsed INI file
+*
+* The file is read and parsed once, then every lookup
+* is a hash table search instead of a new scan of the
+* file. The keys of a section are kept in the order of
+* the file; a section appearing several times is merged
+* into its first occurrence, and only the first value of
+* a key is kept, like the free functions do.
+*/
+    class POLDER_API Document
+    {
+        public:
+
+            /**
+* @brief Key of a section and its value
+*/
+            struct Entry
+            {
+                std::string section;
+                std::string key;
+                std::string value;
+            };
+
+            using const_iterator = std::vector<Entry>::const_iterator;
+
+            /**
+* @brief Creates an empty document
+*/
+            Document();
+
+            /**
+* @brief Reads and parses an INI file
+*
+* @param fname INI file to read
+* @param dialect Dialect used to parse the file
+*/
+            explicit Document(const std::string& fname, Dialect dialect={});
+
+            /**
+* @brief Merges several documents into one
+*
+* Every layer overrides the values of the layers before
+* it. The sections and the keys are in the order of their
+* first appearance.
+*
+* @param layers Documents to merge, by increasing precedence
+* @return Merged document
+*/
+            static auto merge(const std::vector<Document>& layers)
+                -> Document;
+
+            /**
+* @brief Return whether the given section exists or not
+*/
+            auto section_exists(const std::string& section) const
+                -> bool;
+
+            /**
+* @brief Return whether the given key exists or not
+*/
+            auto key_exists(const std::string& section, const std::string& key) const
+                -> bool;
+
+            /**
+* @brief Value of a key, or nullptr if it does not exist
+*/
+            auto find(const std::string& section, const std::string& key) const
+                -> const std::string*;
+
+            /**
+* @brief Read the value corresponding to the given key
+*
+* @param section Section to read
+* @param key Key to read
+* @param default_value Value to return if the key does not exist
+*
+* @return Read value or default value
+*/
+            auto read(const std::string& section, const std::string& key,
+                      const std::string& default_value) const
+                -> Element;
+
+            /**
+* @brief Read the value of a key converted to a given type
+*
+* The supported types are std::string and the
+* arithmetic types Element can be converted to. The
+* first arithmetic type a value is converted to is
+* cached, the next conversions to that type do not
+* parse the value anymore.
+*
+* @param section Section to read
+* @param key Key to read
+* @param default_value Value to return if the key does not exist
+*
+* @return Converted value or default value
+*/
+            template<typename T>
+            auto get(const std::string& section, const std::string& key,
+                     const T& default_value) const
+                -> T;
+
+            /**
+* @brief Names of the sections, in the order of the file
+*/
+            auto sections() const
+                -> const std::vector<std::string>&;
+
+            /**
+* @brief Keys of a section, in the order of the file
+*
+* @param section Section whose keys are wanted
+* @return Range of entries, empty if the section does not exist
+*/
+            auto section(const std::string& section) const
+                -> std::pair<const_iterator, const_iterator>;
+
+            /**
+* @brief Iteration over all the keys, section by section
+*/
+            auto begin() const
+                -> const_iterator;
+            auto end() const
+                -> const_iterator;
+
+            /**
+* @brief Number of keys in the document
+*/
+            auto size() const
+                -> std::size_t;
+
+        private:
+
+            struct SectionIndex
+            {
+                std::size_t first;  // First entry of the section
+                std::size_t last;   // One past its last entry
+                std::unordered_map<std::string, std::size_t> keys;
+            };
+
+            /*
+             * Value of an entry converted to an arithmetic type.
+             * The first thread converting the value claims the
+             * slot, fills it, then publishes the type tag; a slot
+             * never changes type afterwards, so the readers only
+             * need an atomic load. Copies of a slot are empty.
+             */
+            struct CacheSlot
+            {
+                CacheSlot() noexcept:
+                    tag(0)
+                {}
+
+                CacheSlot(const CacheSlot&) noexcept:
+                    tag(0)
+                {}
+
+                auto operator=(const CacheSlot&) noexcept
+                    -> CacheSlot&
+                {
+                    tag.store(0, std::memory_order_relaxed);
+                    return *this;
+                }
+
+                mutable std::atomic<unsigned char> tag;
+                alignas(long double) mutable unsigned char value[sizeof(long double)];
+            };
+
+            auto parse(const char* first, const char* last, Dialect dialect)
+                -> void;
+
+            // Index of an entry, or size() if it does not exist
+            auto find_index(const std::string& section, const std::string& key) const
+                -> std::size_t;
+
+            template<typename T>
+            auto cached(std::size_t index) const
+                -> T;
+
+            std::vector<Entry> _entries;
+            std::vector<CacheSlot> _cache;  // One slot per entry
+            std::vector<std::string> _sections;
+            std::unordered_map<std::string, SectionIndex> _index;
+    };
+
+    /**
+* @brief Parsed INI file referencing a memory mapping
+*
+* The file is mapped in memory instead of being read,
+* and the section names, keys and values are views into
+* the mapping: nothing is copied, and parsing allocates
+* no memory per line. The views remain valid as long as
+* the document exists. Lookups are hash table searches,
+* and the rules are the same as for Document.
+*/
+    class POLDER_API MappedDocument
+    {
+        public:
+
+            /**
+* @brief Key of a section and its value
+*/
+            struct Entry
+            {
+                StringView section;
+                StringView key;
+                StringView value;
+            };
+
+            using const_iterator = std::vector<Entry>::const_iterator;
+
+            /**
+* @brief Maps and parses an INI file
+*
+* @param fname INI file to read
+* @param dialect Dialect used to parse the file
+*/
+            explicit MappedDocument(const std::string& fname, Dialect dialect={});
+
+            MappedDocument(const MappedDocument&) = delete;
+            MappedDocument(MappedDocument&& other) noexcept;
+            ~MappedDocument();
+
+            auto operator=(const MappedDocument&)
+                -> MappedDocument&
+                = delete;
+            auto operator=(MappedDocument&& other) noexcept
+                -> MappedDocument&;
+
+            /**
+* @brief Return whether the given section exists or not
+*/
+            auto section_exists(StringView section) const
+                -> bool;
+
+            /**
+* @brief Return whether the given key exists or not
+*/
+            auto key_exists(StringView section, StringView key) const
+                -> bool;
+
+            /**
+* @brief Value of a key, or nullptr if it does not exist
+*/
+            auto find(StringView section, StringView key) const
+                -> const StringView*;
+
+            /**
+* @brief Read the value corresponding to the given key
+*
+* @param section Section to read
+* @param key Key to read
+* @param default_value Value to return if the key does not exist
+*
+* @return Read value or default value
+*/
+            auto read(StringView section, StringView key, StringView default_value) const
+                -> StringView;
+
+            /**
+* @brief Read the value of a key converted to a given type
+*
+* The supported types are the same as for Document.
+*/
+            template<typename T>
+            auto get(StringView section, StringView key, const T& default_value) const
+                -> T;
+
+            /**
+* @brief Names of the sections, in the order of the file
+*/
+            auto sections() const
+                -> const std::vector<StringView>&;
+
+            /**
+* @brief Keys of a section, in the order of the file
+*/
+            auto section(StringView section) const
+                -> std::pair<const_iterator, const_iterator>;
+
+            /**
+* @brief Iteration over all the keys, section by section
+*/
+            auto begin() const
+                -> const_iterator;
+            auto end() const
+                -> const_iterator;
+
+            /**
+* @brief Number of keys in the document
+*/
+            auto size() const
+                -> std::size_t;
+
+        private:
+
+            auto parse(Dialect dialect)
+                -> void;
+
+            auto find_section(StringView section) const
+                -> std::size_t;
+
+            // Mapped file
+            const char* _data;
+            std::size_t _size;
+            std::vector<char> _buffer;  // Used when the file can not be mapped
+
+            std::vector<Entry> _entries;
+            std::vector<StringView> _sections;
+            std::vector<std::pair<std::size_t, std::size_t>> _ranges;  // Entries of each section
+
+            // Open addressing hash tables, holding
+            // indices + 1 of sections and entries
+            std::vector<std::uint32_t> _section_table;
+            std::vector<std::uint32_t> _key_table;
+    };
+
+    /**
+* @brief INI file whose sections are parsed on demand
+*
+* The file is mapped in memory like for MappedDocument,
+* but opening it only looks for the section headers and
+* records where every section starts; the keys of a
+* section are parsed the first time one of them is looked
+* up. Opening a big file is then about as fast as reading
+* it, and only the sections actually used are parsed.
+*
+* The views remain valid as long as the document exists.
+* Lookups follow the same rules as for Document, and they
+* can be done from several threads at once: every section
+* is parsed only once.
+*/
+    class POLDER_API LazyDocument
+    {
+        public:
+
+            /**
+* @brief Key of a section and its value
+*/
+            struct Entry
+            {
+                StringView section;
+                StringView key;
+                StringView value;
+            };
+
+            using const_iterator = std::vector<Entry>::const_iterator;
+
+            /**
+* @brief Maps an INI file and indexes its sections
+*
+* @param fname INI file to read
+* @param dialect Dialect used to parse the file
+*/
+            explicit LazyDocument(const std::string& fname, Dialect dialect={});
+
+            LazyDocument(const LazyDocument&) = delete;
+            LazyDocument(LazyDocument&& other) noexcept;
+            ~LazyDocument();
+
+            auto operator=(const LazyDocument&)
+                -> LazyDocument&
+                = delete;
+            auto operator=(LazyDocument&& other) noexcept
+                -> LazyDocument&;
+
+            /**
+* @brief Return whether the given section exists or not
+*
+* The section is not parsed.
+*/
+            auto section_exists(StringView section) const
+                -> bool;
+
+            /**
+* @brief Return whether the given key exists or not
+*/
+            auto key_exists(StringView section, StringView key) const
+                -> bool;
+
+            /**
+* @brief Value of a key, or nullptr if it does not exist
+*/
+            auto find(StringView section, StringView key) const
+                -> const StringView*;
+
+            /**
+* @brief Read the value corresponding to the given key
+*
+* @param section Section to read
+* @param key Key to read
+* @param default_value Value to return if the key does not exist
+*
+* @return Read value or default value
+*/
+            auto read(StringView section, StringView key, StringView default_value) const
+                -> StringView;
+
+            /**
+* @brief Read the value of a key converted to a given type
+*
+* The supported types are the same as for Document.
+*/
+            template<typename T>
+            auto get(StringView section, StringView key, const T& default_value) const
+                -> T;
+
+            /**
+* @brief Names of the sections, in the order of the file
+*/
+            auto sections() const
+                -> const std::vector<StringView>&;
+
+            /**
+* @brief Keys of a section, in the order of the file
+*/
+            auto section(StringView section) const
+                -> std::pair<const_iterator, const_iterator>;
+
+        private:
+
+            struct Section;
+
+            // Looks for the section headers
+            auto index()
+                -> void;
+
+            auto find_section(StringView section) const
+                -> std::size_t;
+
+            // Section of the given index, parsed if needed
+            auto load(std::size_t index) const
+                -> const Section&;
+
+            // Mapped file
+            const char* _data;
+            std::size_t _size;
+            std::vector<char> _buffer;  // Used when the file can not be mapped
+            Dialect _dialect;
+
+            std::vector<StringView> _names;
+            std::vector<std::unique_ptr<Section>> _sections;
+
+            // Open addressing hash table, holding
+            // indices + 1 of sections
+            std::vector<std::uint32_t> _section_table;
+    };
+
+    /**
+* @brief Parsed INI file cached in a binary image
+*
+* The first time a file is opened, it is parsed and a
+* binary image of the parsed document, made of a string
+* table and of hash tables of offsets, is written next to
+* it, with the ".cache" extension. The next times, the
+* image is mapped in memory and used as is, without any
+* parsing, as long as the size, the modification time and
+* the hash of the file did not change; the file is still
+* read once to compute its hash.
+*
+* When the image can not be written, it is kept in memory.
+* Lookups follow the same rules as for Document.
+*/
+    class POLDER_API CachedDocument
+    {
+        public:
+
+            /**
+* @brief Reads an INI file, from its image if possible
+*
+* @param fname INI file to read
+* @param dialect Dialect used to parse the file
+*/
+            explicit CachedDocument(const std::string& fname, Dialect dialect={});
+
+            CachedDocument(const CachedDocument&) = delete;
+            CachedDocument(CachedDocument&& other) noexcept;
+            ~CachedDocument();
+
+            auto operator=(const CachedDocument&)
+                -> CachedDocument&
+                = delete;
+            auto operator=(CachedDocument&& other) noexcept
+                -> CachedDocument&;
+
+            /**
+* @brief Whether the document was read from an up-to-date image
+*/
+            auto from_image() const noexcept
+                -> bool;
+
+            /**
+* @brief Return whether the given section exists or not
+*/
+            auto section_exists(StringView section) const
+                -> bool;
+
+            /**
+* @brief Return whether the given key exists or not
+*/
+            auto key_exists(StringView section, StringView key) const
+                -> bool;
+
+            /**
+* @brief Value of a key, or a null view if it does not exist
+*/
+            auto find(StringView section, StringView key) const
+                -> StringView;
+
+            /**
+* @brief Read the value corresponding to the given key
+*/
+            auto read(StringView section, StringView key, StringView default_value) const
+                -> Element;
+
+            /**
+* @brief Read the value of a key converted to a given type
+* @see Document::get
+*/
+            template<typename T>
+            auto get(StringView section, StringView key, const T& default_value) const
+                -> T;
+
+            /**
+* @brief Names of the sections, in the order of the file
+*/
+            auto sections() const
+                -> std::vector<StringView>;
+
+            /**
+* @brief Number of keys in the document
+*/
+            auto size() const
+                -> std::size_t;
+
+        private:
+
+            struct Header;
+            struct SectionRecord;
+            struct EntryRecord;
+
+            // Maps or reads an image, then checks it
+            auto open_image(const std::string& fname)
+                -> bool;
+
+            // Sets the pointers into the image, if it is consistent
+            auto load_image()
+                -> bool;
+
+            auto release()
+                -> void;
+
+            auto string(std::uint32_t offset, std::uint32_t size) const
+                -> StringView;
+
+            // Image
+            const char* _data;
+            std::size_t _size;
+            std::vector<char> _buffer;  // Used when the image is not mapped
+            bool _from_image;
+
+            // Parts of the image
+            const Header* _header;
+            const SectionRecord* _sections;
+            const EntryRecord* _entries;
+            const std::uint32_t* _section_table;
+            const std::uint32_t* _key_table;
+            const char* _strings;
+    };
+
+    /**
+* @brief Forward-only reader of the keys of an INI file
+*
+* The file is read through a buffer of fixed size and
+* the keys are returned one by one, in the order of the
+* file, with views of their section and value; memory
+* usage does not depend on the size of the file, only
+* on the size of its longest line:
+*
+* ini::StreamReader reader("export.ini");
+* while (reader.next())
+* {
+*     if (reader.key() == "id") ...
+* }
+*
+* The lines are parsed with the same rules as Document,
+* but nothing is merged: duplicated sections and keys
+* are returned as many times as they appear.
+*/
+    class POLDER_API StreamReader
+    {
+        public:
+
+            /**
+* @brief Opens an INI file
+*
+* @param fname INI file to read
+* @param dialect Dialect used to parse the file
+* @param buffer_size Initial size of the buffer, grown if
+*        a line does not fit in it
+* @throw Error If the file can not be opened
+*/
+            explicit StreamReader(const std::string& fname, Dialect dialect={},
+                                  std::size_t buffer_size=65536);
+
+            /**
+* @brief Reads the next key
+*
+* The views of the previous key become invalid.
+*
+* @return Whether a key was read, false at the end of the file
+* @throw Error If the file can not be read
+*/
+            auto next()
+                -> bool;
+
+            /**
+* @brief Section, key and value of the current key
+*/
+            auto section() const noexcept
+                -> StringView;
+            auto key() const noexcept
+                -> StringView;
+            auto value() const noexcept
+                -> StringView;
+
+        private:
+
+            template<typename Lines>
+            auto next_key(const Lines& lines)
+                -> bool;
+
+            // Moves the unread characters to the front
+            // of the buffer and reads the next ones
+            auto fill()
+                -> void;
+
+            std::string _fname;
+            std::ifstream _file;
+            Dialect _dialect;
+            std::vector<char> _buffer;
+            std::size_t _first;     // Unread characters of the buffer
+            std::size_t _last;
+            bool _eof;
+
+            // Current key
+            std::string _section;
+            bool _in_section;
+            StringView _key;
+            StringView _value;
+    };
+
+    /**
+* @brief Batch of modifications of an INI file
+*
+* The file is read once, every modification is applied
+* in memory, and the file is only rewritten by commit:
+*
+* ini::Editor ed("config.ini");
+* ed.set("window", "width", "800");
+* ed.set("window", "height", "600");
+* ed.commit();
+*
+* The lines that are not modified are kept as is, with
+* their comments and in the same order. A modified value
+* keeps the key, the spaces and the comment of its line.
+* A file that does not exist is considered empty.
+*
+* A commit replaces the file atomically: the new contents
+* are written and synced to a temporary file in the same
+* directory, which is then renamed over the file. After a
+* crash, the file holds either the old contents or the
+* new ones, never a part of them.
+*/
+    class POLDER_API Editor
+    {
+        public:
+
+            /**
+* @brief Reads an INI file to modify
+*
+* @param fname INI file to modify
+* @param dialect Dialect used to parse the file
+*/
+            explicit Editor(const std::string& fname, Dialect dialect={});
+
+            Editor(const Editor&) = delete;
+            auto operator=(const Editor&)
+                -> Editor&
+                = delete;
+
+            /**
+* @brief Writes the pending changes, if any
+*
+* The errors are passed to the error handler, if any;
+* call flush to handle them otherwise.
+*/
+            ~Editor();
+
+            /**
+* @brief Sets the value of a key
+*
+* The key is added at the end of its section if it does
+* not exist yet, and the section is added at the end of
+* the file if it does not exist either.
+*
+* @param section Section of the key
+* @param key Key to set
+* @param value New value
+*/
+            auto set(const std::string& section, const std::string& key, const std::string& value)
+                -> void;
+            auto set(const std::string& section, const std::string& key, double value)
+                -> void;
+
+            /**
+* @brief Deletes a section and all its lines
+* @throw Error If the section does not exist
+*/
+            auto remove_section(const std::string& section)
+                -> void;
+
+            /**
+* @brief Deletes a key
+* @throw Error If the section or the key does not exist
+*/
+            auto remove_key(const std::string& section, const std::string& key)
+                -> void;
+
+            /**
+* @brief Renames a section
+* @throw Error If the section does not exist or if the
+*        new name is already used
+*/
+            auto rename_section(const std::string& section, const std::string& new_section)
+                -> void;
+
+            /**
+* @brief Renames a key
+* @throw Error If the section or the key does not exist,
+*        or if the new key already exists
+*/
+            auto rename_key(const std::string& section, const std::string& key,
+                            const std::string& new_key)
+                -> void;
+
+            /**
+* @brief Writes the modified file
+*
+* With write-behind, the file is only written if the
+* last write is older than the write-behind delay;
+* otherwise the changes are written by a background
+* thread once the delay expires. If that write failed,
+* the next commit writes the file at once instead.
+*
+* @throw Error If the file can not be written
+*/
+            auto commit()
+                -> void;
+
+            /**
+* @brief Writes the pending changes now
+* @throw Error If the file can not be written
+*/
+            auto flush()
+                -> void;
+
+            /**
+* @brief Batches frequent commits
+*
+* The commits following a write by less than the given
+* delay are grouped into a single write, done by a
+* background thread when the delay expires, or earlier
+* by flush or by the destructor. A null delay writes at
+* every commit.
+*
+* @param delay Minimal time between two writes
+*/
+            auto set_write_behind(std::chrono::milliseconds delay)
+                -> void;
+
+            /**
+* @brief Reports the errors that can not be thrown
+*
+* The handler is called with the errors of the writes
+* done by the background thread or by the destructor;
+* it is called from the background thread for the
+* former.
+*
+* @param handler Function called with every such error
+*/
+            auto set_error_handler(std::function<void(const Error&)> handler)
+                -> void;
+
+        private:
+
+            enum struct Kind
+            {
+                OTHER,      // Blank line, comment...
+                SECTION,    // [section]
+                BROKEN,     // [ without ], ends a section
+                KEY         // key = value
+            };
+
+            struct Line
+            {
+                std::string text;
+                Kind kind;
+                // Positions in text of the section
+                // name or key and of the value
+                std::size_t name_first;
+                std::size_t name_last;
+                std::size_t value_first;
+                std::size_t value_last;
+            };
+
+            using line_iterator = std::list<Line>::iterator;
+
+            // Inserts a line before pos
+            auto add_line(line_iterator pos, std::string text)
+                -> line_iterator;
+
+            // Contents of the modified file
+            auto render() const
+                -> std::string;
+
+            // Writes the committed contents, with _mutex locked
+            auto write_pending()
+                -> void;
+
+            // Background thread of the write-behind
+            auto write_behind()
+                -> void;
+
+            std::string _fname;
+            Dialect _dialect;
+            std::list<Line> _lines;
+            bool _final_terminator;
+
+            // Write-behind: the committed contents are
+            // written by a background thread once the
+            // delay expires, all guarded by _mutex
+            std::chrono::milliseconds _write_behind;
+            std::chrono::steady_clock::time_point _last_write;
+            std::string _contents;
+            bool _pending;
+            bool _failed;   // The last write failed
+            bool _stopped;
+            std::function<void(const Error&)> _error_handler;
+            std::mutex _mutex;
+            std::condition_variable _wake;
+            std::thread _thread;
+
+            // Headers of every section, and line of every
+            // key of a section (the first one if duplicated)
+            std::unordered_map<std::string, std::vector<line_iterator>> _headers;
+            std::unordered_map<std::string, std::unordered_map<std::string, line_iterator>> _keys;
+    };
+
+    /**
+* @brief INI file reloaded when it changes
+*
+* The file is parsed once into an immutable Document, and
+* parsed again by a background thread every time it is
+* written or replaced; the new Document is then published
+* at once by an atomic swap of a shared pointer, so the
+* readers never see a half-parsed file and never wait for
+* a reload.
+*
+* A reader keeps the snapshot it got for as long as it
+* needs it; on hot paths, it only has to get a new one
+* when the version changes, which is a single atomic
+* load:
+*
+* auto doc = watcher.snapshot();
+* auto version = watcher.version();
+* ...
+* if (watcher.version() != version) { ... }
+* const std::string* value = doc->find(section, key);
+*
+* Changes are detected with inotify on Linux, and by
+* checking the file ten times per second on
+* the other systems. When the file can not be read, the
+* previous snapshot is kept.
+*/
+    class POLDER_API Watcher
+    {
+        public:
+
+            /**
+* @brief Reads an INI file and starts watching it
+*
+* @param fname INI file to watch
+* @param dialect Dialect used to parse the file
+* @throw Error If the file can not be read
+*/
+            explicit Watcher(const std::string& fname, Dialect dialect={});
+
+            Watcher(const Watcher&) = delete;
+            auto operator=(const Watcher&)
+                -> Watcher&
+                = delete;
+
+            /**
+* @brief Stops watching the file
+*/
+            ~Watcher();
+
+            /**
+* @brief Current contents of the file
+*/
+            auto snapshot() const
+                -> std::shared_ptr<const Document>;
+
+            /**
+* @brief Number of reloads since the file was first read
+*/
+            auto version() const noexcept
+                -> std::size_t;
+
+            /**
+* @brief Reads the file again now
+* @return Whether the file could be read
+*/
+            auto reload()
+                -> bool;
+
+        private:
+
+            auto watch()
+                -> void;
+
+            std::string _fname;
+            Dialect _dialect;
+            std::shared_ptr<const Document> _snapshot;
+            std::atomic<std::size_t> _version;
+            std::mutex _reload_mutex;
+            std::atomic<bool> _stopped;
+            int _notify;    // inotify instance, -1 when not used
+            std::thread _thread;
+    };
+
 ////////////////////////////////////////////////////////////
 // Exceptions handling
 ////////////////////////////////////////////////////////////
@@ -153,6 +1185,24 @@ POLDER_API
 auto read(const std::string& fname, const std::string& section, const std::string& key, const std::string& default_value, Dialect dialect={})
     -> Element;
 
+/**
+* @brief Reads several INI files as layers of one document
+*
+* The files are parsed concurrently, then merged with
+* Document::merge: every file overrides the values of the
+* files before it.
+*
+* @param fnames INI files to read, by increasing precedence
+* @param dialect Dialect used to parse the files
+* @param nb_threads Maximal number of threads used to parse the
+*        files; 0 means as many as the hardware supports
+* @return Merged document
+* @throw Error If one of the files can not be read
+*/
+POLDER_API
+auto load_layers(const std::vector<std::string>& fnames, Dialect dialect={}, std::size_t nb_threads=0)
+    -> Document;
+
 /**
 * @brief Deletes the given section of an INI file
 *
@@ -23,6 +23,7 @@
 ////////////////////////////////////////////////////////////
 #include <algorithm>
 #include <cmath>
+#include <functional>
 #include <initializer_list>
 #include <numeric>
 #include <ostream>
@@ -230,6 +231,21 @@ namespace polder
             auto swap(Matrix<T>&& other)
                 -> void;
 
+            /**
+             * @brief Changes the dimensions of the Matrix
+             *
+             * The already allocated memory is kept and reused
+             * whenever possible: resizing a Matrix to the shape
+             * it already has does not do anything, and shrinking
+             * it never releases memory. The values of the Matrix
+             * are unspecified after a change of shape.
+             *
+             * @param height New height
+             * @param width New width
+             */
+            auto resize(size_type height, size_type width)
+                -> void;
+
 
             ////////////////////////////////////////////////////////////
             // NumPy-like functions
@@ -460,16 +476,16 @@ namespace polder
 
     // Matrix-Matrix arithmetic operations
     template<typename T>
-    auto operator+(Matrix<T> lhs, const Matrix<T>& rhs)
+    auto operator+(const Matrix<T>& lhs, const Matrix<T>& rhs)
         -> Matrix<T>;
     template<typename T>
-    auto operator-(Matrix<T> lhs, const Matrix<T>& rhs)
+    auto operator-(const Matrix<T>& lhs, const Matrix<T>& rhs)
         -> Matrix<T>;
     template<typename T>
-    auto operator*(Matrix<T> lhs, const Matrix<T>& rhs)
+    auto operator*(const Matrix<T>& lhs, const Matrix<T>& rhs)
         -> Matrix<T>;
     template<typename T>
-    auto operator/(Matrix<T> lhs, const Matrix<T>& rhs)
+    auto operator/(const Matrix<T>& lhs, const Matrix<T>& rhs)
         -> Matrix<T>;
 
     // Matrix-value_type arithmetic operations
@@ -496,7 +512,7 @@ namespace polder
     auto adjugate(const Matrix<T>& mat)
         -> Matrix<T>;
     template<typename T>
-    auto cofactor(const Matrix<T> mat, std::pair<std::size_t, std::size_t> index)
+    auto cofactor(const Matrix<T>& mat, std::pair<std::size_t, std::size_t> index)
         -> typename Matrix<T>::value_type;
     template<typename T>
     auto determinant(const Matrix<T>& mat)
@@ -514,6 +530,53 @@ namespace polder
     auto transpose(const Matrix<T>& mat)
         -> Matrix<T>;
 
+    ////////////////////////////////////////////////////////////
+    // Out-parameter functions
+    ////////////////////////////////////////////////////////////
+
+    // These functions write their result in an existing
+    // Matrix instead of returning a new one. The output
+    // Matrix is resized if needed, but its memory is reused
+    // when its shape already matches the one of the result.
+    // Unless stated otherwise, the output Matrix shall not
+    // be one of the input matrices.
+
+    // Matrix-Matrix arithmetic operations
+    // (add_into and subtract_into accept aliased arguments,
+    // divide_into multiplies lhs by the inverse of rhs)
+    template<typename T>
+    auto add_into(Matrix<T>& out, const Matrix<T>& lhs, const Matrix<T>& rhs)
+        -> Matrix<T>&;
+    template<typename T>
+    auto subtract_into(Matrix<T>& out, const Matrix<T>& lhs, const Matrix<T>& rhs)
+        -> Matrix<T>&;
+    template<typename T>
+    auto multiply_into(Matrix<T>& out, const Matrix<T>& lhs, const Matrix<T>& rhs)
+        -> Matrix<T>&;
+    template<typename T>
+    auto divide_into(Matrix<T>& out, const Matrix<T>& lhs, const Matrix<T>& rhs)
+        -> Matrix<T>&;
+
+    // Matrix-value_type arithmetic operations
+    // (the output Matrix may be the input one)
+    template<typename T>
+    auto multiply_into(Matrix<T>& out, const Matrix<T>& mat, T value)
+        -> Matrix<T>&;
+    template<typename T>
+    auto divide_into(Matrix<T>& out, const Matrix<T>& mat, T value)
+        -> Matrix<T>&;
+
+    // Miscellaneous functions
+    template<typename T>
+    auto adjugate_into(Matrix<T>& out, const Matrix<T>& mat)
+        -> Matrix<T>&;
+    template<typename T>
+    auto inverse_into(Matrix<T>& out, const Matrix<T>& mat)
+        -> Matrix<T>&;
+    template<typename T>
+    auto transpose_into(Matrix<T>& out, const Matrix<T>& mat)
+        -> Matrix<T>&;
+
     #include "details/matrix.inl"
 }
 
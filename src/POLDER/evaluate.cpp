@@ -15,13 +15,29 @@
  * License along with this program. If not,
  * see <http://www.gnu.org/licenses/>.
  */
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <cctype>
 #include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <sstream>
-#include <stack>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 #include <POLDER/evaluate.h>
-#include <POLDER/math/factorial.h>
+#include <POLDER/exceptions.h>
+#include <POLDER/math/formula.h>
+#include <POLDER/rational.h>
 
 
 namespace polder
@@ -66,7 +82,28 @@ namespace
         BNOT,       // ~ (Bitwise NOT)
 
         // Handled postfix unary operators
-        FAC         // ! (Factorial)
+        FAC,        // ! (Factorial)
+
+        // Internal unary operators
+        SQR,        // x * x
+        BOOL,       // x != 0
+
+        // Handled ternary operator
+        COND,       // ?:
+
+        // Built-in functions calls
+        CALL1,          // Call a function with one argument
+        CALL2,          // Call a function with two arguments
+
+        // Other instructions
+        PUSH,           // Push a literal value
+        LOAD,           // Push the value of a variable
+        STORE,          // Copy the top value to a temporary
+        FETCH,          // Push the value of a temporary
+        JUMP,           // Jump to the target
+        JUMP_IF_FALSE,  // Pop the top value, jump if it is false
+        AND_JUMP,       // If the top value is false, replace it by 0 and jump, else pop it
+        OR_JUMP         // If the top value is true, replace it by 1 and jump, else pop it
     };
 
     constexpr const char* op_str[] = {
@@ -92,12 +129,37 @@ namespace
         "<",
         "^",
         "//",
+        "",
         "-",
         "!",
         "~",
-        "!"
+        "!",
+        "**",
+        "",
+        "?:",
+        "",
+        "",
+        "",
+        "",
+        "",
+        "",
+        "",
+        "",
+        "",
+        ""
     };
 
+    // Size of the values stack allocated on the
+    // program stack when evaluating an expression
+    constexpr std::size_t stack_buffer_size = 64;
+
+    // Number of rows evaluated at once by
+    // each instruction in batch evaluation
+    constexpr std::size_t batch_block_size = 256;
+
+    // Text of a literal in the expression
+    using literal = std::pair<const char*, const char*>;
+
     // Binary operators priority
     // The priority of unary operators is
     // determined by their position
@@ -125,93 +187,596 @@ namespace
         5,   // ^^
         11,  // //
     };
+}
+
+namespace
+{
+    ////////////////////////////////////////////////////////////
+    // Built-in functions
+    ////////////////////////////////////////////////////////////
+
+    auto sign(double x)
+        -> double
+    {
+        return math::sign(x);
+    }
+
+    struct builtin
+    {
+        const char* name;
+        std::size_t arity;
+        double (*unary_function)(double);
+        double (*binary_function)(double, double);
+    };
+
+    const builtin builtins[] = {
+        { "abs",        1,  std::fabs,                  nullptr     },
+        { "sqrt",       1,  std::sqrt,                  nullptr     },
+        { "cbrt",       1,  std::cbrt,                  nullptr     },
+        { "exp",        1,  std::exp,                   nullptr     },
+        { "log",        1,  std::log,                   nullptr     },
+        { "log2",       1,  std::log2,                  nullptr     },
+        { "log10",      1,  std::log10,                 nullptr     },
+        { "sin",        1,  std::sin,                   nullptr     },
+        { "cos",        1,  std::cos,                   nullptr     },
+        { "tan",        1,  std::tan,                   nullptr     },
+        { "asin",       1,  std::asin,                  nullptr     },
+        { "acos",       1,  std::acos,                  nullptr     },
+        { "atan",       1,  std::atan,                  nullptr     },
+        { "sinh",       1,  std::sinh,                  nullptr     },
+        { "cosh",       1,  std::cosh,                  nullptr     },
+        { "tanh",       1,  std::tanh,                  nullptr     },
+        { "floor",      1,  std::floor,                 nullptr     },
+        { "ceil",       1,  std::ceil,                  nullptr     },
+        { "round",      1,  std::round,                 nullptr     },
+        { "trunc",      1,  std::trunc,                 nullptr     },
+        { "sign",       1,  sign,                       nullptr     },
+        { "degrees",    1,  math::degrees<double>,      nullptr     },
+        { "radians",    1,  math::radians<double>,      nullptr     },
+        { "sinc",       1,  math::sinc<double>,         nullptr     },
+        { "min",        2,  nullptr,                    std::fmin   },
+        { "max",        2,  nullptr,                    std::fmax   },
+        { "pow",        2,  nullptr,                    std::pow    },
+        { "atan2",      2,  nullptr,                    std::atan2  },
+        { "hypot",      2,  nullptr,                    std::hypot  },
+        { "fmod",       2,  nullptr,                    std::fmod   }
+    };
+
+    constexpr std::size_t no_builtin = 255;
 
-    // Element types
-    enum struct elem_t
+    // Perfect hash of the names of the built-in functions;
+    // it only has to be updated when a function is added
+    auto builtin_hash(const char* name, std::size_t length)
+        -> std::size_t
     {
-        OPERAND,
-        OPERATOR,
-        PREFIX,
-        POSTFIX,
-        PARENTHESIS
+        return (std::size_t((unsigned char) name[0])
+              + 31 * std::size_t((unsigned char) name[1])
+              + 9 * std::size_t((unsigned char) name[length-1])
+              + length) % 64;
+    }
+
+    // Index in builtins for every hash value
+    constexpr unsigned char builtin_slots[64] = {
+         14,  16,  19,  22, 255,  24, 255, 255, 255, 255, 255,   7,  20,   0, 255,  12,
+        255, 255,   6,  26,   9, 255,  13, 255, 255,   2, 255, 255, 255, 255, 255,  15,
+          3,  29,   8,   5, 255, 255, 255,  25,  28,  23, 255, 255,  18,  11,  17, 255,
+         10,  21, 255, 255,  27, 255, 255, 255, 255, 255,   1, 255, 255, 255, 255,   4
     };
 
-    struct Token
+    // Index of the built-in function with the
+    // given name, or no_builtin if there is none
+    auto find_builtin(const char* name, std::size_t length)
+        -> std::size_t
     {
-        elem_t type;
-        union
+        // Names of the built-in functions have
+        // between 3 and 7 characters
+        if (length < 3 || length > 7)
         {
-            char par;       // parenthesis
-            op_t op;        // operator
-            double data;    // real value
-        };
+            return no_builtin;
+        }
+        std::size_t idx = builtin_slots[builtin_hash(name, length)];
+        if (idx == no_builtin
+            || std::strncmp(builtins[idx].name, name, length) != 0
+            || builtins[idx].name[length] != '\0')
+        {
+            return no_builtin;
+        }
+        return idx;
+    }
+
+    ////////////////////////////////////////////////////////////
+    // Operations
+    ////////////////////////////////////////////////////////////
+
+    // The operator is a template parameter so that the
+    // switch is resolved at compile time, which allows
+    // to inline the operations in the evaluation loops
+
+    // The integer operators work on the operands truncated
+    // to int; their result is NaN when the operation is not
+    // defined for these operands
+
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+
+    // Whether the value truncated to int is defined
+    auto fits_int(double a)
+        -> bool
+    {
+        return a > std::numeric_limits<int>::min() - 1.0
+            && a < std::numeric_limits<int>::max() + 1.0;
+    }
+
+    // Whether a // b and a % b are defined: the division
+    // by zero and INT_MIN // -1 are not
+    auto integer_division(double a, double b)
+        -> bool
+    {
+        if (not (fits_int(a) && fits_int(b)))
+        {
+            return false;
+        }
+        return (int) b != 0 && not ((int) a == std::numeric_limits<int>::min() && (int) b == -1);
+    }
+
+    // Whether a << b and a >> b are defined: the shift
+    // count must be smaller than the width of an int
+    auto integer_shift(double a, double b)
+        -> bool
+    {
+        return fits_int(a) && fits_int(b) && (int) b >= 0 && (int) b < 32;
+    }
+
+    template<int Op>
+    auto bitwise(double a, double b)
+        -> double
+    {
+        if (not (fits_int(a) && fits_int(b)))
+        {
+            return nan;
+        }
+        switch (Op)
+        {
+            case op_t::BAND: return (int) a & (int) b;
+            case op_t::BXOR: return (int) a ^ (int) b;
+            case op_t::BOR: return (int) a | (int) b;
+        }
+    }
+
+    // Factorial of the natural numbers whose
+    // factorial is a finite double, NaN otherwise
+    auto factorial(double a)
+        -> double
+    {
+        if (not (a >= 0.0 && a <= 170.0) || a != std::floor(a))
+        {
+            return nan;
+        }
+        double res = 1.0;
+        for (int i = 2 ; i <= (int) a ; ++i)
+        {
+            res *= i;
+        }
+        return res;
+    }
+
+    template<int Op>
+    auto operation(double a, double b)
+        -> double
+    {
+        switch (Op)
+        {
+            case op_t::ADD: return a + b;                       // +
+            case op_t::SUB: return a - b;                       // -
+            case op_t::MUL: return a * b;                       // *
+            case op_t::LT: return a < b;                        // <
+            case op_t::GT: return a > b;                        // >
+            case op_t::DIV: return a / b;                       // /
+            case op_t::IDIV:                                    // //
+                return integer_division(a, b) ? (int) a / (int) b : nan;
+            case op_t::MOD:                                     // %
+                return integer_division(a, b) ? (int) a % (int) b : nan;
+            case op_t::BAND: return bitwise<op_t::BAND>(a, b);  // &
+            case op_t::BXOR: return bitwise<op_t::BXOR>(a, b);  // ^
+            case op_t::BOR: return bitwise<op_t::BOR>(a, b);    // |
+            case op_t::EQ: return a == b;                       // ==
+            case op_t::NE: return a != b;                       // != or <>
+            case op_t::GE: return a >= b;                       // >=
+            case op_t::LE: return a <= b;                       // <=
+            case op_t::AND: return a && b;                      // &&
+            case op_t::XOR: return (a && !b) || (b && !a);      // ^^
+            case op_t::OR: return a || b;                       // ||
+            case op_t::POW: return std::pow(a, b);              // **
+            case op_t::SPACE: return (a < b) ? -1 : (a != b);   // <=>
+            case op_t::LSHIFT:                                  // <<
+                // The bits shifted out are lost
+                return integer_shift(a, b) ? (int) ((unsigned) (int) a << (int) b) : nan;
+            case op_t::RSHIFT:                                  // >>
+                return integer_shift(a, b) ? (int) a >> (int) b : nan;
+        }
+    }
+
+    template<int Op>
+    auto operation(double a)
+        -> double
+    {
+        switch (Op)
+        {
+            case op_t::USUB: return -a;                                 // -
+            case op_t::NOT: return !a;                                  // ! (prefix)
+            case op_t::BNOT: return fits_int(a) ? ~ (int) a : nan;      // ~
+            case op_t::FAC: return factorial(a);                        // ! (postfix)
+            case op_t::SQR: return a * a;                               // ** 2
+            case op_t::BOOL: return a != 0.0;                           // conversion
+        }
+    }
+
+    template<int Op>
+    auto operation(double a, double b, double c)
+        -> double
+    {
+        switch (Op)
+        {
+            case op_t::COND: return a ? b : c;  // ?:
+        }
+    }
+
+    ////////////////////////////////////////////////////////////
+    // Values stacks
+    ////////////////////////////////////////////////////////////
+
+    /**
+     * Values stack used to evaluate an expression
+     * for a single set of arguments.
+     */
+    struct scalar_stack
+    {
+        double* top;    // One past the top of the stack
+        double* temps;  // Temporaries
+
+        template<int Op>
+        auto binary()
+            -> void
+        {
+            --top;
+            top[-1] = operation<Op>(top[-1], top[0]);
+        }
+
+        template<int Op>
+        auto unary()
+            -> void
+        {
+            top[-1] = operation<Op>(top[-1]);
+        }
+
+        template<int Op>
+        auto ternary()
+            -> void
+        {
+            top -= 2;
+            top[-1] = operation<Op>(top[-1], top[0], top[1]);
+        }
+
+        auto call(double (*func)(double))
+            -> void
+        {
+            top[-1] = func(top[-1]);
+        }
+
+        auto call(double (*func)(double, double))
+            -> void
+        {
+            --top;
+            top[-1] = func(top[-1], top[0]);
+        }
+    };
+
+    /**
+     * Values stack used to evaluate an expression
+     * over a block of rows at once. Every level of
+     * the stack points either to a column of the
+     * arguments or to its own block of scratch memory.
+     */
+    struct batch_stack
+    {
+        const double** temps;   // Temporaries, followed by the stack
+        const double** base;    // First level of the stack
+        const double** top;     // One past the top of the stack
+        double* scratch;        // One block per level
+        std::size_t size;       // Number of rows in the block
+
+        // Scratch block of a given level
+        auto block(const double** level) const
+            -> double*
+        {
+            return scratch + (level - temps) * batch_block_size;
+        }
 
-        Token():
-            type(elem_t::OPERAND),
-            data(0.0)
-        {}
+        template<int Op>
+        auto binary()
+            -> void
+        {
+            --top;
+            const double* a = top[-1];
+            const double* b = top[0];
+            double* res = block(top - 1);
+            for (std::size_t i = 0 ; i < size ; ++i)
+            {
+                res[i] = operation<Op>(a[i], b[i]);
+            }
+            top[-1] = res;
+        }
 
-        Token(char p):
-            type(elem_t::PARENTHESIS),
-            par(p)
-        {}
+        template<int Op>
+        auto unary()
+            -> void
+        {
+            const double* a = top[-1];
+            double* res = block(top - 1);
+            for (std::size_t i = 0 ; i < size ; ++i)
+            {
+                res[i] = operation<Op>(a[i]);
+            }
+            top[-1] = res;
+        }
 
-        Token(double d):
-            type(elem_t::OPERAND),
-            data(d)
-        {}
+        template<int Op>
+        auto ternary()
+            -> void
+        {
+            top -= 2;
+            const double* a = top[-1];
+            const double* b = top[0];
+            const double* c = top[1];
+            double* res = block(top - 1);
+            for (std::size_t i = 0 ; i < size ; ++i)
+            {
+                res[i] = operation<Op>(a[i], b[i], c[i]);
+            }
+            top[-1] = res;
+        }
 
-        Token(op_t o):
-            type(elem_t::OPERATOR),
-            op(o)
+        auto call(double (*func)(double))
+            -> void
         {
-            if (o == op_t::USUB
-                || o == op_t::NOT
-                || o == op_t::BNOT)
+            const double* a = top[-1];
+            double* res = block(top - 1);
+            for (std::size_t i = 0 ; i < size ; ++i)
             {
-                type = elem_t::PREFIX;
+                res[i] = func(a[i]);
             }
-            else if (o == op_t::FAC)
+            top[-1] = res;
+        }
+
+        auto call(double (*func)(double, double))
+            -> void
+        {
+            --top;
+            const double* a = top[-1];
+            const double* b = top[0];
+            double* res = block(top - 1);
+            for (std::size_t i = 0 ; i < size ; ++i)
             {
-                type = elem_t::POSTFIX;
+                res[i] = func(a[i], b[i]);
             }
+            top[-1] = res;
         }
     };
 }
 
+namespace
+{
+    ////////////////////////////////////////////////////////////
+    // Cache of compiled expressions
+    ////////////////////////////////////////////////////////////
+
+    /**
+     * Process-wide cache of compiled expressions, indexed
+     * by their source text. It is split into shards that
+     * have their own lock and their own LRU list, so that
+     * threads looking for different expressions seldom
+     * wait for each other.
+     */
+    class expression_cache
+    {
+        public:
+
+            static auto instance()
+                -> expression_cache&
+            {
+                static expression_cache cache;
+                return cache;
+            }
+
+            auto capacity() const
+                -> std::size_t
+            {
+                return _capacity.load(std::memory_order_relaxed);
+            }
+
+            auto find(const std::string& key)
+                -> std::shared_ptr<const expression>
+            {
+                shard& sh = shard_for(key);
+                std::lock_guard<std::mutex> lock(sh.mutex);
+
+                auto it = sh.entries.find(key);
+                if (it == sh.entries.end())
+                {
+                    ++sh.misses;
+                    return nullptr;
+                }
+                ++sh.hits;
+                sh.order.splice(sh.order.begin(), sh.order, it->second.position);
+                return it->second.expr;
+            }
+
+            auto insert(const std::string& key, expression&& expr)
+                -> std::shared_ptr<const expression>
+            {
+                auto memory = key.capacity() + expr.memory_usage() + entry_overhead;
+                auto res = std::make_shared<const expression>(std::move(expr));
+
+                shard& sh = shard_for(key);
+                std::lock_guard<std::mutex> lock(sh.mutex);
+
+                // Expressions too big for a shard are not kept
+                auto max_memory = capacity() / nb_shards;
+                if (memory > max_memory)
+                {
+                    return res;
+                }
+
+                // Another thread may have compiled it too
+                auto ins = sh.entries.emplace(key, entry());
+                if (not ins.second)
+                {
+                    return ins.first->second.expr;
+                }
+
+                entry& e = ins.first->second;
+                e.expr = res;
+                e.memory = memory;
+                sh.order.push_front(&ins.first->first);
+                e.position = sh.order.begin();
+                sh.memory += memory;
+                evict(sh, max_memory);
+                return res;
+            }
+
+            auto set_capacity(std::size_t bytes)
+                -> void
+            {
+                _capacity.store(bytes, std::memory_order_relaxed);
+                for (shard& sh: _shards)
+                {
+                    std::lock_guard<std::mutex> lock(sh.mutex);
+                    evict(sh, bytes / nb_shards);
+                }
+            }
+
+            auto clear()
+                -> void
+            {
+                for (shard& sh: _shards)
+                {
+                    std::lock_guard<std::mutex> lock(sh.mutex);
+                    sh.entries.clear();
+                    sh.order.clear();
+                    sh.memory = sh.hits = sh.misses = sh.evictions = 0;
+                }
+            }
+
+            auto statistics()
+                -> cache_statistics
+            {
+                cache_statistics res;
+                for (shard& sh: _shards)
+                {
+                    std::lock_guard<std::mutex> lock(sh.mutex);
+                    res.hits += sh.hits;
+                    res.misses += sh.misses;
+                    res.evictions += sh.evictions;
+                    res.entries += sh.entries.size();
+                    res.memory += sh.memory;
+                }
+                res.capacity = capacity();
+                return res;
+            }
+
+        private:
+
+            static constexpr std::size_t nb_shards = 16;
+            static constexpr std::size_t default_capacity = 4 * 1024 * 1024;
+
+            // Approximate memory used by the containers
+            // for every entry, besides the expression
+            static constexpr std::size_t entry_overhead = 128;
+
+            struct entry
+            {
+                std::shared_ptr<const expression> expr;
+                std::list<const std::string*>::iterator position;
+                std::size_t memory;
+            };
+
+            // Aligned to avoid false sharing
+            // between the locks of the shards
+            struct alignas(64) shard
+            {
+                std::mutex mutex;
+                std::unordered_map<std::string, entry> entries;
+                std::list<const std::string*> order; // Most recently used first
+                std::size_t memory = 0;
+                std::size_t hits = 0;
+                std::size_t misses = 0;
+                std::size_t evictions = 0;
+            };
+
+            expression_cache():
+                _capacity(default_capacity)
+            {}
+
+            auto shard_for(const std::string& key)
+                -> shard&
+            {
+                return _shards[std::hash<std::string>()(key) % nb_shards];
+            }
+
+            static auto evict(shard& sh, std::size_t max_memory)
+                -> void
+            {
+                while (sh.memory > max_memory)
+                {
+                    auto it = sh.entries.find(*sh.order.back());
+                    sh.memory -= it->second.memory;
+                    sh.order.pop_back();
+                    sh.entries.erase(it);
+                    ++sh.evictions;
+                }
+            }
+
+            std::atomic<std::size_t> _capacity;
+            std::array<shard, nb_shards> _shards;
+    };
+}
+
 // Error codes
 enum struct eval_error_code
 {
     UNKNOWN_OPERATOR,
     UNEXPECTED_CHARACTER,
-    NOT_ENOUGH_OPERANDS
+    NOT_ENOUGH_OPERANDS,
+    UNKNOWN_VARIABLE,
+    UNKNOWN_FUNCTION,
+    WRONG_NUMBER_OF_ARGUMENTS
 };
 
 // Lexer and parser
-auto tokenize(const std::string& expr)
-    -> std::vector<Token>;
-auto postfix(const std::vector<Token>& vec)
-    -> std::stack<Token>;
-auto eval_postfix(std::stack<Token>&& S)
+auto parse_number(const char*& it, const char* last)
     -> double;
-
-// Miscellaneous
-auto operation(double a, op_t op)
-    -> Token;
-auto operation(double a, double b, op_t op)
-    -> Token;
-auto priority(const Token& token)
-    -> int;
-
-// Type checking
-auto is_operand(const Token& token)
-    -> bool;
-auto is_operator(const Token& token)
-    -> bool;
-auto is_prefix(const Token& token)
-    -> bool;
-auto is_postfix(const Token& token)
-    -> bool;
+auto parse(const char* first, const char* last,
+           std::vector<std::string>& variables, bool add_variables,
+           bool short_circuit, details::program& prog,
+           std::vector<literal>* literals=nullptr)
+    -> void;
+
+// Code generation and execution
+auto optimize(details::program& prog, details::program& batch_prog)
+    -> void;
+auto execute(const details::instruction* first,
+             const details::instruction* last,
+             const double* args, double* temps, double* stack)
+    -> double;
+auto run(const details::program& prog, const double* args)
+    -> double;
+auto execute_batch(const details::instruction* first,
+                   const details::instruction* last,
+                   const double* const* columns, std::size_t offset,
+                   batch_stack& st, double* out)
+    -> void;
+template<typename Stack>
+auto dispatch(int op, Stack& stack)
+    -> void;
 
 ////////////////////////////////////////////////////////////
 // Evaluation function
@@ -220,442 +785,2162 @@ auto is_postfix(const Token& token)
 auto evaluate(const std::string& expr)
     -> double
 {
-    auto tokens = tokenize(expr);
-    return eval_postfix(postfix(tokens));
+    auto& cache = expression_cache::instance();
+    if (cache.capacity() > 0)
+    {
+        auto compiled = cache.find(expr);
+        if (not compiled)
+        {
+            expression res = compile(expr);
+            if (not res.variables().empty())
+            {
+                throw evaluation_error(eval_error_code::UNKNOWN_VARIABLE,
+                                       res.variables().front());
+            }
+            compiled = cache.insert(expr, std::move(res));
+        }
+        return (*compiled)();
+    }
+
+    // Reuse the same buffers between calls
+    // to avoid reallocating them every time
+    thread_local details::program prog;
+    thread_local std::vector<std::string> no_variables;
+
+    parse(expr.data(), expr.data() + expr.size(), no_variables, false, true, prog);
+    return run(prog, nullptr);
+}
+
+auto compile(const std::string& expr)
+    -> expression
+{
+    return compile(expr, {});
+}
+
+auto compile(const std::string& expr, const std::vector<std::string>& variables)
+    -> expression
+{
+    expression res;
+    res._variables = variables;
+
+    // New variables are accepted only when no list of
+    // variables is given; the short-circuits are added
+    // by the optimizer
+    parse(expr.data(), expr.data() + expr.size(),
+          res._variables, variables.empty(), false, res._program);
+    optimize(res._program, res._batch_program);
+    return res;
+}
+
+////////////////////////////////////////////////////////////
+// Compiled expression
+////////////////////////////////////////////////////////////
+
+auto expression::operator()() const
+    -> double
+{
+    if (not _variables.empty())
+    {
+        throw evaluation_error("no value given for the variables of the expression");
+    }
+    return run(_program, nullptr);
+}
+
+auto expression::operator()(const double* args) const
+    -> double
+{
+    return run(_program, args);
+}
+
+auto expression::operator()(std::initializer_list<double> args) const
+    -> double
+{
+    POLDER_ASSERT(args.size() >= _variables.size());
+    return run(_program, args.begin());
+}
+
+auto expression::evaluate_batch(const double* const* columns, std::size_t size, double* out) const
+    -> void
+{
+    // The short-circuits can not be used on blocks
+    // of values, a branch-free program is used instead
+    const details::program& prog = _batch_program.code.empty() ? _program : _batch_program;
+    if (prog.code.empty())
+    {
+        throw evaluation_error("evaluation of an empty expression");
+    }
+
+    // Reuse the same buffers between calls; each level of
+    // the stack needs a block of scratch memory
+    thread_local std::vector<const double*> levels;
+    thread_local std::vector<double> scratch;
+    auto nb_levels = prog.nb_temporaries + prog.stack_size;
+    levels.resize(std::max(levels.size(), nb_levels));
+    scratch.resize(std::max(scratch.size(), nb_levels * batch_block_size));
+
+    batch_stack st = {
+        levels.data(), levels.data() + prog.nb_temporaries,
+        nullptr, scratch.data(), 0
+    };
+    const details::instruction* first = prog.code.data();
+    for (std::size_t offset = 0 ; offset < size ; offset += batch_block_size)
+    {
+        st.size = std::min(batch_block_size, size - offset);
+        execute_batch(first, first + prog.code.size(),
+                      columns, offset, st, out + offset);
+    }
+}
+
+auto expression::variables() const
+    -> const std::vector<std::string>&
+{
+    return _variables;
+}
+
+auto expression::slot(const std::string& name) const
+    -> std::size_t
+{
+    auto it = std::find(_variables.begin(), _variables.end(), name);
+    if (it == _variables.end())
+    {
+        throw evaluation_error(eval_error_code::UNKNOWN_VARIABLE, name);
+    }
+    return it - _variables.begin();
+}
+
+auto expression::memory_usage() const
+    -> std::size_t
+{
+    auto res = sizeof(expression)
+             + (_program.code.capacity() + _batch_program.code.capacity())
+               * sizeof(details::instruction)
+             + _variables.capacity() * sizeof(std::string);
+    for (const auto& name: _variables)
+    {
+        res += name.capacity();
+    }
+    return res;
+}
+
+////////////////////////////////////////////////////////////
+// Cache of compiled expressions
+////////////////////////////////////////////////////////////
+
+auto expression_cache_statistics()
+    -> cache_statistics
+{
+    return expression_cache::instance().statistics();
+}
+
+auto set_expression_cache_capacity(std::size_t bytes)
+    -> void
+{
+    expression_cache::instance().set_capacity(bytes);
+}
+
+auto clear_expression_cache()
+    -> void
+{
+    expression_cache::instance().clear();
 }
 
 ////////////////////////////////////////////////////////////
 // Lexer and Parser
 ////////////////////////////////////////////////////////////
 
-auto tokenize(const std::string& expr)
-    -> std::vector<Token>
+namespace
 {
-    std::vector<Token> res;
+    /**
+     * Precedence-climbing parser. The lexemes are read one
+     * at a time, and the instructions are emitted as soon
+     * as the operands of an operator have been parsed, so
+     * the expression is parsed in a single pass without
+     * any intermediate container.
+     */
+    class parser
+    {
+        public:
+
+            parser(const char* first, const char* last,
+                   std::vector<std::string>& variables, bool add_variables,
+                   bool short_circuit, details::program& prog,
+                   std::vector<literal>* literals):
+                _it(first),
+                _last(last),
+                _text(first),
+                _variables(variables),
+                _add_variables(add_variables),
+                _short_circuit(short_circuit),
+                _prog(prog),
+                _literals(literals),
+                _depth(0),
+                _max_depth(0),
+                _nesting(0)
+            {}
+
+            auto parse()
+                -> void
+            {
+                next();
+                if (_current.kind == kind_t::END)
+                {
+                    throw evaluation_error("empty expression");
+                }
+                parse_conditional();
+
+                switch (_current.kind)
+                {
+                    case kind_t::END:
+                        break;
+                    case kind_t::CLOSE:
+                        throw evaluation_error("trying to close a non-opened parenthesis");
+                    case kind_t::COLON:
+                        throw evaluation_error("':' without matching '?' in the expression");
+                    case kind_t::COMMA:
+                        throw evaluation_error(eval_error_code::UNEXPECTED_CHARACTER, ',');
+                    default:
+                        throw evaluation_error("missing operator in the expression");
+                }
+
+                _prog.stack_size = _max_depth;
+                _prog.nb_temporaries = 0;
+            }
+
+        private:
+
+            enum struct kind_t
+            {
+                END,
+                NUMBER,
+                VARIABLE,
+                FUNCTION,
+                OPERATOR,
+                OPEN,
+                CLOSE,
+                COMMA,
+                QUESTION,
+                COLON
+            };
+
+            struct lexeme
+            {
+                kind_t kind;
+                union
+                {
+                    int op;             // OPERATOR
+                    double value;       // NUMBER
+                    std::size_t index;  // VARIABLE, FUNCTION
+                };
+            };
+
+            ////////////////////////////////////////////////////////////
+            // Lexer
+
+            auto accept(char c)
+                -> bool
+            {
+                if (_it != _last && *_it == c)
+                {
+                    ++_it;
+                    return true;
+                }
+                return false;
+            }
+
+            auto set(kind_t kind)
+                -> void
+            {
+                _current.kind = kind;
+            }
+
+            auto set_operator(int op)
+                -> void
+            {
+                _current.kind = kind_t::OPERATOR;
+                _current.op = op;
+            }
+
+            // Reads the next lexeme; the operators '-' and '!'
+            // are read as SUB and FAC, the parser knows whether
+            // they are actually prefix operators
+            auto next()
+                -> void
+            {
+                // Skip all kinds of spaces
+                while (_it != _last && std::isspace(*_it))
+                {
+                    ++_it;
+                }
+                _text = _it;
+
+                if (_it == _last)
+                {
+                    set(kind_t::END);
+                    return;
+                }
+
+                if (std::isdigit(*_it))
+                {
+                    // Found a number
+                    _current.kind = kind_t::NUMBER;
+                    _current.value = parse_number(_it, _last);
+                    return;
+                }
+
+                if (std::isalpha(*_it) || *_it == '_')
+                {
+                    // Found a variable or a function
+                    read_identifier();
+                    return;
+                }
+
+                switch (*_it++)
+                {
+                    case '(': set(kind_t::OPEN);        break;
+                    case ')': set(kind_t::CLOSE);       break;
+                    case ',': set(kind_t::COMMA);       break;
+                    case '?': set(kind_t::QUESTION);    break;
+                    case ':': set(kind_t::COLON);       break;
+                    case '+': set_operator(op_t::ADD);  break;
+                    case '-': set_operator(op_t::SUB);  break;
+                    case '%': set_operator(op_t::MOD);  break;
+                    case '~': set_operator(op_t::BNOT); break;
+                    case '=': set_operator(op_t::EQ);   break;
+
+                    case '*': // * or **
+                        set_operator(accept('*') ? op_t::POW : op_t::MUL);
+                        break;
+
+                    case '&': // & or &&
+                        set_operator(accept('&') ? op_t::AND : op_t::BAND);
+                        break;
+
+                    case '|': // | or ||
+                        set_operator(accept('|') ? op_t::OR : op_t::BOR);
+                        break;
+
+                    case '^': // ^ or ^^
+                        set_operator(accept('^') ? op_t::XOR : op_t::BXOR);
+                        break;
+
+                    case '/': // / or //
+                        set_operator(accept('/') ? op_t::IDIV : op_t::DIV);
+                        break;
+
+                    case '<': // <, <=, <=>, << and <>
+                        if (accept('<'))
+                        {
+                            set_operator(op_t::LSHIFT);
+                        }
+                        else if (accept('>'))
+                        {
+                            set_operator(op_t::NE);
+                        }
+                        else if (accept('='))
+                        {
+                            set_operator(accept('>') ? op_t::SPACE : op_t::LE);
+                        }
+                        else
+                        {
+                            set_operator(op_t::LT);
+                        }
+                        break;
+
+                    case '>': // >, >= and >>
+                        if (accept('>'))
+                        {
+                            set_operator(op_t::RSHIFT);
+                        }
+                        else
+                        {
+                            set_operator(accept('=') ? op_t::GE : op_t::GT);
+                        }
+                        break;
+
+                    case '!': // ! (prefix or postfix) and !=
+                        set_operator(accept('=') ? op_t::NE : op_t::FAC);
+                        break;
+
+                    default:
+                        throw evaluation_error(eval_error_code::UNKNOWN_OPERATOR, _it[-1]);
+                }
+            }
+
+            auto read_identifier()
+                -> void
+            {
+                const char* first = _it;
+                while (_it != _last && (std::isalnum(*_it) || *_it == '_'))
+                {
+                    ++_it;
+                }
+
+                // An identifier followed by a parenthesis
+                // is the name of a built-in function
+                const char* next = _it;
+                while (next != _last && std::isspace(*next))
+                {
+                    ++next;
+                }
+                if (next != _last && *next == '(')
+                {
+                    auto func = find_builtin(first, _it - first);
+                    if (func == no_builtin)
+                    {
+                        throw evaluation_error(eval_error_code::UNKNOWN_FUNCTION,
+                                               std::string(first, _it));
+                    }
+                    _current.kind = kind_t::FUNCTION;
+                    _current.index = func;
+                    return;
+                }
+
+                // Look for an existing variable first; there are
+                // few variables, a linear search is good enough
+                _current.kind = kind_t::VARIABLE;
+                auto length = std::size_t(_it - first);
+                for (std::size_t i = 0 ; i < _variables.size() ; ++i)
+                {
+                    if (_variables[i].size() == length
+                        && std::equal(first, _it, _variables[i].begin()))
+                    {
+                        _current.index = i;
+                        return;
+                    }
+                }
+
+                if (not _add_variables)
+                {
+                    throw evaluation_error(eval_error_code::UNKNOWN_VARIABLE,
+                                           std::string(first, _it));
+                }
+                _variables.emplace_back(first, _it);
+                _current.index = _variables.size() - 1;
+            }
+
+            ////////////////////////////////////////////////////////////
+            // Parser
+
+            // Lowest priority: c ? a : b, right-associative
+            auto parse_conditional()
+                -> void
+            {
+                enter();
+                parse_binary(0);
+                if (_current.kind != kind_t::QUESTION)
+                {
+                    --_nesting;
+                    return;
+                }
+                next();
+
+                if (_short_circuit)
+                {
+                    auto jump_else = emit_jump(op_t::JUMP_IF_FALSE);
+                    parse_conditional();
+                    expect_colon();
+                    auto jump_end = emit_jump(op_t::JUMP);
+                    patch(jump_else);
+                    --_depth;
+                    parse_conditional();
+                    patch(jump_end);
+                }
+                else
+                {
+                    parse_conditional();
+                    expect_colon();
+                    parse_conditional();
+                    emit(op_t::COND, -2);
+                }
+                --_nesting;
+            }
+
+            // Binary operators whose priority is
+            // at least min_priority, left-associative
+            auto parse_binary(unsigned int min_priority)
+                -> void
+            {
+                parse_unary();
+                while (_current.kind == kind_t::OPERATOR
+                       && _current.op < op_t::NB_BINARY_OPERATORS
+                       && _priority[_current.op] >= min_priority)
+                {
+                    int op = _current.op;
+                    next();
+
+                    if (_short_circuit && (op == op_t::AND || op == op_t::OR))
+                    {
+                        // The right operand is skipped if the
+                        // left one is enough to know the result
+                        auto jump = emit_jump(op == op_t::AND ? op_t::AND_JUMP : op_t::OR_JUMP);
+                        parse_operand(op, _priority[op] + 1);
+                        emit(op_t::BOOL, 0);
+                        patch(jump);
+                    }
+                    else
+                    {
+                        parse_operand(op, _priority[op] + 1);
+                        emit(op, -1);
+                    }
+                }
+            }
+
+            // Right operand of a binary operator
+            auto parse_operand(int op, unsigned int min_priority)
+                -> void
+            {
+                if (not starts_operand())
+                {
+                    throw evaluation_error(eval_error_code::NOT_ENOUGH_OPERANDS, op_str[op]);
+                }
+                parse_binary(min_priority);
+            }
+
+            // Prefix operators apply before postfix ones
+            auto parse_unary()
+                -> void
+            {
+                parse_prefix();
+                while (_current.kind == kind_t::OPERATOR && _current.op == op_t::FAC)
+                {
+                    emit(op_t::FAC, 0);
+                    next();
+                }
+            }
+
+            auto parse_prefix()
+                -> void
+            {
+                if (_current.kind != kind_t::OPERATOR)
+                {
+                    parse_primary();
+                    return;
+                }
+
+                int op;
+                switch (_current.op)
+                {
+                    case op_t::SUB:     op = op_t::USUB;    break;
+                    case op_t::FAC:     op = op_t::NOT;     break;
+                    case op_t::BNOT:    op = op_t::BNOT;    break;
+                    default:
+                        throw evaluation_error(eval_error_code::NOT_ENOUGH_OPERANDS,
+                                               op_str[_current.op]);
+                }
+                next();
+                if (not starts_operand())
+                {
+                    throw evaluation_error(eval_error_code::NOT_ENOUGH_OPERANDS, op_str[op]);
+                }
+                enter();
+                parse_prefix();
+                --_nesting;
+                emit(op, 0);
+            }
+
+            auto parse_primary()
+                -> void
+            {
+                details::instruction instr;
+                switch (_current.kind)
+                {
+                    case kind_t::NUMBER:
+                        instr.op = op_t::PUSH;
+                        if (_literals)
+                        {
+                            // The literal is converted later
+                            instr.index = _literals->size();
+                            _literals->emplace_back(_text, _it);
+                        }
+                        else
+                        {
+                            instr.value = _current.value;
+                        }
+                        emit(instr, 1);
+                        next();
+                        break;
+
+                    case kind_t::VARIABLE:
+                        instr.op = op_t::LOAD;
+                        instr.index = _current.index;
+                        emit(instr, 1);
+                        next();
+                        break;
+
+                    case kind_t::FUNCTION:
+                        parse_call(builtins[_current.index]);
+                        break;
+
+                    case kind_t::OPEN:
+                        next();
+                        if (_current.kind == kind_t::CLOSE)
+                        {
+                            throw evaluation_error("empty parenthesis in the expression");
+                        }
+                        parse_conditional();
+                        expect_close();
+                        break;
+
+                    case kind_t::END:
+                        throw evaluation_error("unexpected end of the expression");
+
+                    default:
+                        throw evaluation_error(eval_error_code::UNEXPECTED_CHARACTER, *_text);
+                }
+            }
+
+            auto parse_call(const builtin& func)
+                -> void
+            {
+                // The lexer already checked the parenthesis
+                next();
+                next();
+
+                std::size_t nb_args = 0;
+                if (_current.kind != kind_t::CLOSE)
+                {
+                    parse_conditional();
+                    ++nb_args;
+                    while (_current.kind == kind_t::COMMA)
+                    {
+                        next();
+                        parse_conditional();
+                        ++nb_args;
+                    }
+                }
+                if (nb_args != func.arity)
+                {
+                    throw evaluation_error(eval_error_code::WRONG_NUMBER_OF_ARGUMENTS, func.name);
+                }
+                expect_close();
+
+                details::instruction instr;
+                if (func.arity == 1)
+                {
+                    instr.op = op_t::CALL1;
+                    instr.unary_function = func.unary_function;
+                }
+                else
+                {
+                    instr.op = op_t::CALL2;
+                    instr.binary_function = func.binary_function;
+                }
+                emit(instr, 1 - int(func.arity));
+            }
+
+            auto starts_operand() const
+                -> bool
+            {
+                switch (_current.kind)
+                {
+                    case kind_t::NUMBER:
+                    case kind_t::VARIABLE:
+                    case kind_t::FUNCTION:
+                    case kind_t::OPEN:
+                        return true;
+                    case kind_t::OPERATOR:
+                        return _current.op == op_t::SUB
+                            || _current.op == op_t::FAC
+                            || _current.op == op_t::BNOT;
+                    default:
+                        return false;
+                }
+            }
+
+            auto expect_close()
+                -> void
+            {
+                if (_current.kind != kind_t::CLOSE)
+                {
+                    if (_current.kind == kind_t::END)
+                    {
+                        throw evaluation_error("mismatched parenthesis in the expression");
+                    }
+                    if (_current.kind == kind_t::COMMA)
+                    {
+                        throw evaluation_error(eval_error_code::UNEXPECTED_CHARACTER, ',');
+                    }
+                    throw evaluation_error("missing operator in the expression");
+                }
+                next();
+            }
+
+            // The parser is recursive: deeply nested
+            // expressions would overflow the stack
+            auto enter()
+                -> void
+            {
+                if (++_nesting > max_nesting)
+                {
+                    throw evaluation_error("expression nested too deeply");
+                }
+            }
+
+            auto expect_colon()
+                -> void
+            {
+                if (_current.kind != kind_t::COLON)
+                {
+                    throw evaluation_error("missing ':' in conditional expression");
+                }
+                next();
+            }
+
+            ////////////////////////////////////////////////////////////
+            // Code generation
+
+            // Emits an instruction which changes the
+            // depth of the values stack by effect
+            auto emit(const details::instruction& instr, int effect)
+                -> void
+            {
+                _prog.code.push_back(instr);
+                _depth += effect;
+                _max_depth = std::max(_max_depth, _depth);
+            }
+
+            auto emit(int op, int effect)
+                -> void
+            {
+                details::instruction instr;
+                instr.op = op;
+                instr.index = 0;
+                emit(instr, effect);
+            }
+
+            // Emits a jump whose target is patched later; the
+            // conditional jumps pop the value they check
+            auto emit_jump(int op)
+                -> std::size_t
+            {
+                emit(op, op == op_t::JUMP ? 0 : -1);
+                return _prog.code.size() - 1;
+            }
+
+            // Makes the jump land on the next instruction
+            auto patch(std::size_t jump)
+                -> void
+            {
+                _prog.code[jump].index = _prog.code.size();
+            }
+
+            // Source
+            const char* _it;
+            const char* _last;
+            const char* _text;  // Text of the current lexeme
+
+            // Variables
+            std::vector<std::string>& _variables;
+            bool _add_variables;
+
+            // Generated code
+            bool _short_circuit;
+            details::program& _prog;
+            std::vector<literal>* _literals;    // Text of the literals, if needed
+            int _depth;
+            int _max_depth;
+
+            // Nested subexpressions
+            static constexpr int max_nesting = 1000;
+            int _nesting;
+
+            lexeme _current;
+    };
+}
+
+auto parse(const char* first, const char* last,
+           std::vector<std::string>& variables, bool add_variables,
+           bool short_circuit, details::program& prog,
+           std::vector<literal>* literals)
+    -> void
+{
+    prog.code.clear();
+    if (literals)
+    {
+        literals->clear();
+    }
+    parser(first, last, variables, add_variables, short_circuit, prog, literals).parse();
+}
+
+auto parse_number(const char*& it, const char* last)
+    -> double
+{
+    // Powers of ten exactly representable by a double
+    static constexpr double exact_pow10[] = {
+        1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+        1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+        1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+
+    const char* first = it;
+    std::uint64_t mantissa = 0;
+    int nb_digits = 0;
+    int nb_decimals = 0;
+    bool has_dot = false;
+
+    for (; it != last && (std::isdigit(*it) || *it == '.') ; ++it)
+    {
+        if (*it == '.')
+        {
+            if (has_dot)
+            {
+                // Two dots in the same number: error
+                throw evaluation_error(eval_error_code::UNEXPECTED_CHARACTER, '.');
+            }
+            // We just confirmed we found a real number
+            has_dot = true;
+            continue;
+        }
+
+        if (mantissa != 0 || *it != '0')
+        {
+            ++nb_digits;
+        }
+        mantissa = mantissa * 10 + (*it - '0');
+        nb_decimals += has_dot;
+    }
+
+    // Fast path: both the mantissa and the power of ten are
+    // exact doubles, so the division is correctly rounded
+    if (nb_digits <= 15 && nb_decimals <= 22)
+    {
+        return double(mantissa) / exact_pow10[nb_decimals];
+    }
+
+    // Slow path, for numbers with many significant digits;
+    // the copy is needed because std::strtod could read
+    // further than the number (exponents, hexadecimal...)
+    char buffer[64];
+    auto length = it - first;
+    if (length < std::ptrdiff_t(sizeof buffer))
+    {
+        std::copy(first, it, buffer);
+        buffer[length] = '\0';
+        return std::strtod(buffer, nullptr);
+    }
+    return std::stod(std::string(first, it));
+}
+
+////////////////////////////////////////////////////////////
+// Code generation and execution
+////////////////////////////////////////////////////////////
+
+auto execute(const details::instruction* first,
+             const details::instruction* last,
+             const double* args, double* temps, double* stack)
+    -> double
+{
+    scalar_stack st = { stack, temps };
+
+    for (auto it = first ; it != last ; ++it)
+    {
+        switch (it->op)
+        {
+            case op_t::PUSH:
+                *st.top++ = it->value;
+                break;
+            case op_t::LOAD:
+                *st.top++ = args[it->index];
+                break;
+            case op_t::STORE:
+                st.temps[it->index] = st.top[-1];
+                break;
+            case op_t::FETCH:
+                *st.top++ = st.temps[it->index];
+                break;
+            case op_t::CALL1:
+                st.call(it->unary_function);
+                break;
+            case op_t::CALL2:
+                st.call(it->binary_function);
+                break;
+            // The jumps land right before the target
+            // since the loop increments the iterator
+            case op_t::JUMP:
+                it = first + it->index - 1;
+                break;
+            case op_t::JUMP_IF_FALSE:
+                if (not *--st.top)
+                {
+                    it = first + it->index - 1;
+                }
+                break;
+            case op_t::AND_JUMP:
+                if (not st.top[-1])
+                {
+                    st.top[-1] = 0.0;
+                    it = first + it->index - 1;
+                }
+                else
+                {
+                    --st.top;
+                }
+                break;
+            case op_t::OR_JUMP:
+                if (st.top[-1])
+                {
+                    st.top[-1] = 1.0;
+                    it = first + it->index - 1;
+                }
+                else
+                {
+                    --st.top;
+                }
+                break;
+            default:
+                dispatch(it->op, st);
+        }
+    }
+    return st.top[-1];
+}
+
+auto execute_batch(const details::instruction* first,
+                   const details::instruction* last,
+                   const double* const* columns, std::size_t offset,
+                   batch_stack& st, double* out)
+    -> void
+{
+    st.top = st.base;
+
+    for (auto it = first ; it != last ; ++it)
+    {
+        switch (it->op)
+        {
+            case op_t::PUSH:
+            {
+                double* res = st.block(st.top);
+                std::fill(res, res + st.size, it->value);
+                *st.top++ = res;
+                break;
+            }
+            case op_t::LOAD:
+                *st.top++ = columns[it->index] + offset;
+                break;
+            case op_t::STORE:
+            {
+                // The block of the current level will be
+                // overwritten, the values have to be copied
+                const double** temp = st.temps + it->index;
+                double* res = st.block(temp);
+                std::copy(st.top[-1], st.top[-1] + st.size, res);
+                *temp = res;
+                break;
+            }
+            case op_t::FETCH:
+                *st.top++ = st.temps[it->index];
+                break;
+            case op_t::CALL1:
+                st.call(it->unary_function);
+                break;
+            case op_t::CALL2:
+                st.call(it->binary_function);
+                break;
+            default:
+                dispatch(it->op, st);
+        }
+    }
+    std::copy(st.top[-1], st.top[-1] + st.size, out);
+}
+
+auto run(const details::program& prog, const double* args)
+    -> double
+{
+    if (prog.code.empty())
+    {
+        // Default-constructed expression
+        throw evaluation_error("evaluation of an empty expression");
+    }
+    const details::instruction* first = prog.code.data();
+    const details::instruction* last = first + prog.code.size();
+
+    // The temporaries are stored right before the stack
+    if (prog.nb_temporaries + prog.stack_size <= stack_buffer_size)
+    {
+        double frame[stack_buffer_size];
+        return execute(first, last, args, frame, frame + prog.nb_temporaries);
+    }
+    std::vector<double> frame(prog.nb_temporaries + prog.stack_size);
+    return execute(first, last, args, frame.data(), frame.data() + prog.nb_temporaries);
+}
+
+template<typename Stack>
+auto dispatch(int op, Stack& stack)
+    -> void
+{
+    switch (op)
+    {
+        // Binary operators
+        case op_t::ADD:     stack.template binary<op_t::ADD>();     break;
+        case op_t::SUB:     stack.template binary<op_t::SUB>();     break;
+        case op_t::MUL:     stack.template binary<op_t::MUL>();     break;
+        case op_t::DIV:     stack.template binary<op_t::DIV>();     break;
+        case op_t::IDIV:    stack.template binary<op_t::IDIV>();    break;
+        case op_t::MOD:     stack.template binary<op_t::MOD>();     break;
+        case op_t::POW:     stack.template binary<op_t::POW>();     break;
+        case op_t::LT:      stack.template binary<op_t::LT>();      break;
+        case op_t::GT:      stack.template binary<op_t::GT>();      break;
+        case op_t::EQ:      stack.template binary<op_t::EQ>();      break;
+        case op_t::NE:      stack.template binary<op_t::NE>();      break;
+        case op_t::GE:      stack.template binary<op_t::GE>();      break;
+        case op_t::LE:      stack.template binary<op_t::LE>();      break;
+        case op_t::SPACE:   stack.template binary<op_t::SPACE>();   break;
+        case op_t::AND:     stack.template binary<op_t::AND>();     break;
+        case op_t::OR:      stack.template binary<op_t::OR>();      break;
+        case op_t::XOR:     stack.template binary<op_t::XOR>();     break;
+        case op_t::BAND:    stack.template binary<op_t::BAND>();    break;
+        case op_t::BOR:     stack.template binary<op_t::BOR>();     break;
+        case op_t::BXOR:    stack.template binary<op_t::BXOR>();    break;
+        case op_t::LSHIFT:  stack.template binary<op_t::LSHIFT>();  break;
+        case op_t::RSHIFT:  stack.template binary<op_t::RSHIFT>();  break;
+
+        // Unary operators
+        case op_t::USUB:    stack.template unary<op_t::USUB>();     break;
+        case op_t::NOT:     stack.template unary<op_t::NOT>();      break;
+        case op_t::BNOT:    stack.template unary<op_t::BNOT>();     break;
+        case op_t::FAC:     stack.template unary<op_t::FAC>();      break;
+        case op_t::SQR:     stack.template unary<op_t::SQR>();      break;
+        case op_t::BOOL:    stack.template unary<op_t::BOOL>();     break;
+
+        // Ternary operator
+        case op_t::COND:    stack.template ternary<op_t::COND>();   break;
+
+        // Should never happen
+        default:
+            throw evaluation_error();
+    }
+}
+
+////////////////////////////////////////////////////////////
+// Optimization
+////////////////////////////////////////////////////////////
+
+namespace
+{
+    /**
+     * Directed acyclic graph of an expression.
+     *
+     * Identical nodes are only created once, which merges
+     * the common subexpressions. The constant nodes are
+     * folded and the trivial operations are simplified
+     * as soon as the nodes are created.
+     */
+    class expression_graph
+    {
+        public:
+
+            static constexpr std::size_t npos = std::size_t(-1);
+
+            auto constant(double value)
+                -> std::size_t
+            {
+                std::uint64_t bits;
+                std::memcpy(&bits, &value, sizeof bits);
+                auto id = insert(op_t::PUSH, npos, npos, npos, bits);
+                _nodes[id].value = value;
+                return id;
+            }
+
+            auto variable(std::size_t slot)
+                -> std::size_t
+            {
+                return insert(op_t::LOAD, npos, npos, npos, slot);
+            }
+
+            auto unary(int op, std::size_t operand)
+                -> std::size_t
+            {
+                if (is_constant(operand))
+                {
+                    double args[] = { value(operand) };
+                    if (can_fold(op, args, 1))
+                    {
+                        return constant(fold(op, args, 1));
+                    }
+                }
+                // - -x => x
+                if (op == op_t::USUB && _nodes[operand].op == op_t::USUB)
+                {
+                    return _nodes[operand].args[0];
+                }
+                // The value is already 0 or 1
+                if (op == op_t::BOOL && is_boolean(operand))
+                {
+                    return operand;
+                }
+                return insert(op, operand, npos, npos, 0);
+            }
+
+            auto binary(int op, std::size_t lhs, std::size_t rhs)
+                -> std::size_t
+            {
+                if (is_constant(lhs) && is_constant(rhs))
+                {
+                    double args[] = { value(lhs), value(rhs) };
+                    if (can_fold(op, args, 2))
+                    {
+                        return constant(fold(op, args, 2));
+                    }
+                }
+
+                switch (op)
+                {
+                    case op_t::ADD: // x+0 => x, 0+x => x
+                        if (is_constant(rhs, 0.0)) return lhs;
+                        if (is_constant(lhs, 0.0)) return rhs;
+                        break;
+                    case op_t::SUB: // x-0 => x
+                        if (is_constant(rhs, 0.0)) return lhs;
+                        break;
+                    case op_t::MUL: // x*1 => x, 1*x => x
+                        if (is_constant(rhs, 1.0)) return lhs;
+                        if (is_constant(lhs, 1.0)) return rhs;
+                        break;
+                    case op_t::DIV: // x/1 => x
+                        if (is_constant(rhs, 1.0)) return lhs;
+                        break;
+                    case op_t::POW: // x**0 => 1, x**1 => x, x**2 => x*x
+                        if (is_constant(rhs, 0.0)) return constant(1.0);
+                        if (is_constant(rhs, 1.0)) return lhs;
+                        if (is_constant(rhs, 2.0)) return unary(op_t::SQR, lhs);
+                        break;
+                    case op_t::AND: // 0 && x => 0, 1 && x => bool(x)
+                        if (is_constant(lhs))
+                        {
+                            return value(lhs) ? unary(op_t::BOOL, rhs) : constant(0.0);
+                        }
+                        break;
+                    case op_t::OR: // 1 || x => 1, 0 || x => bool(x)
+                        if (is_constant(lhs))
+                        {
+                            return value(lhs) ? constant(1.0) : unary(op_t::BOOL, rhs);
+                        }
+                        break;
+                }
+                return insert(op, lhs, rhs, npos, 0);
+            }
+
+            auto ternary(int op, std::size_t cond, std::size_t lhs, std::size_t rhs)
+                -> std::size_t
+            {
+                // Only the selected branch matters
+                if (is_constant(cond))
+                {
+                    return value(cond) ? lhs : rhs;
+                }
+                if (lhs == rhs)
+                {
+                    return lhs;
+                }
+                return insert(op, cond, lhs, rhs, 0);
+            }
+
+            /**
+             * Call to a built-in function. The functions are
+             * pure, so calls with constant arguments are folded.
+             */
+            auto call(const details::instruction& instr, std::size_t lhs, std::size_t rhs)
+                -> std::size_t
+            {
+                std::uint64_t key;
+                if (instr.op == op_t::CALL1)
+                {
+                    if (is_constant(lhs))
+                    {
+                        return constant(instr.unary_function(value(lhs)));
+                    }
+                    key = reinterpret_cast<std::uintptr_t>(instr.unary_function);
+                }
+                else
+                {
+                    if (is_constant(lhs) && is_constant(rhs))
+                    {
+                        return constant(instr.binary_function(value(lhs), value(rhs)));
+                    }
+                    key = reinterpret_cast<std::uintptr_t>(instr.binary_function);
+                }
+                auto id = insert(instr.op, lhs, rhs, npos, key);
+                _nodes[id].function = instr;
+                return id;
+            }
+
+            /**
+             * Number of nodes on the longest path from
+             * the given node to a leaf.
+             */
+            auto height(std::size_t id) const
+                -> std::size_t
+            {
+                return _nodes[id].height;
+            }
+
+            /**
+             * Generates the code computing the given node. The
+             * nodes used several times are stored in temporaries
+             * the first time they are computed. The logical and
+             * conditional operators jump over the operands they
+             * do not need unless branchless is true, in which
+             * case every operand is computed.
+             */
+            auto generate(std::size_t root, details::program& prog, bool branchless)
+                -> void
+            {
+                for (node& n: _nodes)
+                {
+                    n.uses = 0;
+                    n.temp = npos;
+                }
+                count_uses(root);
+
+                _branchless = branchless;
+                _depth = _max_depth = 0;
+                _nb_temps = 0;
+                _stored.clear();
+                prog.code.clear();
+                emit(root, prog.code);
+                prog.stack_size = _max_depth;
+                prog.nb_temporaries = _nb_temps;
+            }
+
+        private:
+
+            struct node
+            {
+                int op;
+                std::size_t args[3];    // Operands
+                union
+                {
+                    double value;                   // PUSH
+                    std::size_t index;              // LOAD
+                    details::instruction function;  // CALL1, CALL2
+                };
+                std::size_t uses;       // Number of parents
+                std::size_t temp;       // Temporary, if any
+                std::size_t height;     // Longest path to a leaf
+            };
+
+            using key_type = std::tuple<int, std::size_t, std::size_t, std::size_t, std::uint64_t>;
+
+            auto insert(int op, std::size_t a0, std::size_t a1, std::size_t a2,
+                        std::uint64_t data)
+                -> std::size_t
+            {
+                auto key = key_type(op, a0, a1, a2, data);
+                auto it = _index.find(key);
+                if (it != _index.end())
+                {
+                    return it->second;
+                }
+
+                node n;
+                n.op = op;
+                n.args[0] = a0;
+                n.args[1] = a1;
+                n.args[2] = a2;
+                n.index = data;
+                n.uses = 0;
+                n.temp = npos;
+                n.height = 1;
+                for (std::size_t arg: n.args)
+                {
+                    if (arg != npos)
+                    {
+                        n.height = std::max(n.height, _nodes[arg].height + 1);
+                    }
+                }
+                _nodes.push_back(n);
+                _index.emplace(key, _nodes.size() - 1);
+                return _nodes.size() - 1;
+            }
+
+            auto is_constant(std::size_t id) const
+                -> bool
+            {
+                return _nodes[id].op == op_t::PUSH;
+            }
+
+            auto is_constant(std::size_t id, double val) const
+                -> bool
+            {
+                return is_constant(id) && _nodes[id].value == val;
+            }
+
+            auto is_boolean(std::size_t id) const
+                -> bool
+            {
+                switch (_nodes[id].op)
+                {
+                    case op_t::EQ: case op_t::NE:
+                    case op_t::LT: case op_t::GT:
+                    case op_t::LE: case op_t::GE:
+                    case op_t::AND: case op_t::OR:
+                    case op_t::NOT: case op_t::BOOL:
+                        return true;
+                }
+                return false;
+            }
+
+            auto value(std::size_t id) const
+                -> double
+            {
+                return _nodes[id].value;
+            }
+
+            /*
+             * Whether an operation on constants can be computed
+             * at compile time. The divisions that are not
+             * defined are kept: they may be under a logical or
+             * a conditional operator whose condition is later
+             * folded, in which case they are never computed.
+             */
+            static auto can_fold(int op, const double* args, std::size_t arity)
+                -> bool
+            {
+                if (arity == 2 && (op == op_t::IDIV || op == op_t::MOD))
+                {
+                    return integer_division(args[0], args[1]);
+                }
+                return true;
+            }
+
+            // Computes an operation on constants with the
+            // same code as the one used for evaluation
+            static auto fold(int op, double* args, std::size_t arity)
+                -> double
+            {
+                scalar_stack st = { args + arity, nullptr };
+                dispatch(op, st);
+                return args[0];
+            }
+
+            auto count_uses(std::size_t id)
+                -> void
+            {
+                // The operands are only counted
+                // the first time a node is reached
+                if (_nodes[id].uses++ > 0)
+                {
+                    return;
+                }
+                for (std::size_t arg: _nodes[id].args)
+                {
+                    if (arg != npos)
+                    {
+                        count_uses(arg);
+                    }
+                }
+            }
+
+            auto emit_jump(int op, std::vector<details::instruction>& code)
+                -> std::size_t
+            {
+                details::instruction instr;
+                instr.op = op;
+                instr.index = 0; // Patched later
+                code.push_back(instr);
+                return code.size() - 1;
+            }
+
+            // Emits code that may be skipped: the temporaries
+            // stored there can not be fetched afterwards
+            auto emit_conditional(std::size_t id, std::vector<details::instruction>& code)
+                -> void
+            {
+                auto nb_stored = _stored.size();
+                emit(id, code);
+                for (auto i = nb_stored ; i < _stored.size() ; ++i)
+                {
+                    _nodes[_stored[i]].temp = npos;
+                }
+                _stored.resize(nb_stored);
+            }
+
+            auto emit(std::size_t id, std::vector<details::instruction>& code)
+                -> void
+            {
+                node& n = _nodes[id];
+                details::instruction instr;
+
+                if (n.temp != npos)
+                {
+                    // Already computed
+                    instr.op = op_t::FETCH;
+                    instr.index = n.temp;
+                    code.push_back(instr);
+                    _max_depth = std::max(_max_depth, ++_depth);
+                    return;
+                }
+
+                if (n.op == op_t::PUSH || n.op == op_t::LOAD)
+                {
+                    instr.op = n.op;
+                    instr.index = n.index;
+                    code.push_back(instr);
+                    _max_depth = std::max(_max_depth, ++_depth);
+                    return;
+                }
+
+                if (not _branchless && (n.op == op_t::AND || n.op == op_t::OR))
+                {
+                    // The right operand is skipped if the
+                    // left one is enough to know the result
+                    emit(n.args[0], code);
+                    auto jump = emit_jump(n.op == op_t::AND ? op_t::AND_JUMP : op_t::OR_JUMP, code);
+                    --_depth;
+                    emit_conditional(n.args[1], code);
+                    instr.op = op_t::BOOL;
+                    instr.index = 0;
+                    code.push_back(instr);
+                    code[jump].index = code.size();
+                }
+                else if (not _branchless && n.op == op_t::COND)
+                {
+                    emit(n.args[0], code);
+                    auto jump_else = emit_jump(op_t::JUMP_IF_FALSE, code);
+                    --_depth;
+                    emit_conditional(n.args[1], code);
+                    auto jump_end = emit_jump(op_t::JUMP, code);
+                    --_depth;
+                    code[jump_else].index = code.size();
+                    emit_conditional(n.args[2], code);
+                    code[jump_end].index = code.size();
+                }
+                else
+                {
+                    std::size_t arity = 0;
+                    for (std::size_t arg: n.args)
+                    {
+                        if (arg != npos)
+                        {
+                            emit(arg, code);
+                            ++arity;
+                        }
+                    }
+                    _depth -= arity - 1;
+                    if (n.op == op_t::CALL1 || n.op == op_t::CALL2)
+                    {
+                        instr = n.function;
+                    }
+                    else
+                    {
+                        instr.op = n.op;
+                        instr.index = 0;
+                    }
+                    code.push_back(instr);
+                }
+
+                if (n.uses > 1)
+                {
+                    n.temp = _nb_temps++;
+                    _stored.push_back(id);
+                    instr.op = op_t::STORE;
+                    instr.index = n.temp;
+                    code.push_back(instr);
+                }
+            }
+
+            std::vector<node> _nodes;
+            std::map<key_type, std::size_t> _index;
+
+            // Code generation state
+            bool _branchless;
+            std::size_t _depth;
+            std::size_t _max_depth;
+            std::size_t _nb_temps;
+            std::vector<std::size_t> _stored;
+    };
+
+    // The code generation is recursive: it is skipped for
+    // the graphs whose height could overflow the stack
+    constexpr std::size_t max_graph_height = 2000;
+
+    constexpr std::size_t expression_graph::npos;
+}
+
+auto optimize(details::program& prog, details::program& batch_prog)
+    -> void
+{
+    expression_graph graph;
+    std::vector<std::size_t> operands;
+
+    // The code has already been validated
+    // by generate, no need to check it again
+    for (const auto& instr: prog.code)
+    {
+        switch (instr.op)
+        {
+            case op_t::PUSH:
+                operands.push_back(graph.constant(instr.value));
+                break;
+            case op_t::LOAD:
+                operands.push_back(graph.variable(instr.index));
+                break;
+            case op_t::COND:
+            {
+                auto rhs = operands.back();
+                operands.pop_back();
+                auto lhs = operands.back();
+                operands.pop_back();
+                operands.back() = graph.ternary(instr.op, operands.back(), lhs, rhs);
+                break;
+            }
+            case op_t::CALL1:
+                operands.back() = graph.call(instr, operands.back(), expression_graph::npos);
+                break;
+            case op_t::CALL2:
+            {
+                auto rhs = operands.back();
+                operands.pop_back();
+                operands.back() = graph.call(instr, operands.back(), rhs);
+                break;
+            }
+            default:
+            {
+                auto operand = operands.back();
+                operands.pop_back();
+                if (instr.op < op_t::NB_BINARY_OPERATORS)
+                {
+                    operands.back() = graph.binary(instr.op, operands.back(), operand);
+                }
+                else
+                {
+                    operands.push_back(graph.unary(instr.op, operand));
+                }
+            }
+        }
+    }
+
+    if (graph.height(operands.back()) > max_graph_height)
+    {
+        // Keep the code of the parser, which is
+        // correct, only slower
+        batch_prog.code.clear();
+        return;
+    }
+
+    graph.generate(operands.back(), prog, false);
+    prog.code.shrink_to_fit();
+
+    // The batch evaluation needs branch-free code
+    batch_prog.code.clear();
+    for (const auto& instr: prog.code)
+    {
+        if (instr.op >= op_t::JUMP)
+        {
+            graph.generate(operands.back(), batch_prog, true);
+            batch_prog.code.shrink_to_fit();
+            break;
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////
+// Exact evaluation
+////////////////////////////////////////////////////////////
+
+namespace
+{
+    using rational_t = rational<long long>;
+
+    ////////////////////////////////////////////////////////////
+    // Integers
+
+    auto checked_divisor(long long b)
+        -> long long
+    {
+        if (b == 0)
+        {
+            throw division_by_zero();
+        }
+        return b;
+    }
+
+    // The operations on long long throw instead
+    // of overflowing, which is undefined
+
+    const long long llong_min = std::numeric_limits<long long>::min();
+    const long long llong_max = std::numeric_limits<long long>::max();
+
+    auto overflow_error()
+        -> evaluation_error
+    {
+        return evaluation_error("integer overflow in an exact expression");
+    }
+
+    auto checked_add(long long a, long long b)
+        -> long long
+    {
+        if ((b > 0 && a > llong_max - b) || (b < 0 && a < llong_min - b))
+        {
+            throw overflow_error();
+        }
+        return a + b;
+    }
+
+    auto checked_subtract(long long a, long long b)
+        -> long long
+    {
+        if ((b < 0 && a > llong_max + b) || (b > 0 && a < llong_min + b))
+        {
+            throw overflow_error();
+        }
+        return a - b;
+    }
+
+    auto checked_multiply(long long a, long long b)
+        -> long long
+    {
+        bool overflows;
+        if (a > 0)
+        {
+            overflows = (b > 0) ? a > llong_max / b : b < llong_min / a;
+        }
+        else
+        {
+            overflows = (b > 0) ? a < llong_min / b : (a != 0 && b < llong_max / a);
+        }
+        if (overflows)
+        {
+            throw overflow_error();
+        }
+        return a * b;
+    }
+
+    auto checked_negate(long long a)
+        -> long long
+    {
+        if (a == llong_min)
+        {
+            throw overflow_error();
+        }
+        return -a;
+    }
+
+    auto checked_divide(long long a, long long b)
+        -> long long
+    {
+        if (checked_divisor(b) == -1 && a == llong_min)
+        {
+            throw overflow_error();
+        }
+        return a / b;
+    }
+
+    auto checked_modulo(long long a, long long b)
+        -> long long
+    {
+        if (checked_divisor(b) == -1 && a == llong_min)
+        {
+            throw overflow_error();
+        }
+        return a % b;
+    }
 
-    // Number of parenthesis
-    int nmb_parenthesis = 0;
+    auto checked_shift_count(long long b)
+        -> long long
+    {
+        if (b < 0 || b > 63)
+        {
+            throw evaluation_error("shift count out of range: " + std::to_string(b));
+        }
+        return b;
+    }
 
-    for (auto it = expr.cbegin() ; it != expr.cend() ; ++it)
+    auto checked_left_shift(long long a, long long b)
+        -> long long
     {
-        // Skip all kinds of spaces
-        while (std::isspace(*it))
+        checked_shift_count(b);
+        if (a > (llong_max >> b) || a < (llong_min >> b))
         {
-            ++it;
+            throw overflow_error();
         }
-        if (*it == '\0')
+        return static_cast<long long>(static_cast<unsigned long long>(a) << b);
+    }
+
+    auto integer_power(long long a, long long b)
+        -> long long
+    {
+        if (b < 0)
         {
-            break;
+            // Truncated result of 1 / a**-b
+            if (a == 0)
+            {
+                throw division_by_zero();
+            }
+            if (a == 1 || a == -1)
+            {
+                return (a == -1 && b % 2) ? -1 : 1;
+            }
+            return 0;
         }
 
-        if (std::isdigit(*it))
+        long long res = 1;
+        while (b)
         {
-            // Found a number
-            auto tmp = it;
-            bool has_dot = false;
-            while (std::isdigit(*it) || *it == '.')
+            if (b & 1)
             {
-                if (*it == '.')
-                {
-                    if (has_dot)
-                    {
-                        // Two dots in the same number: error
-                        throw evaluation_error(eval_error_code::UNEXPECTED_CHARACTER, '.');
-                    }
-                    else
-                    {
-                        // We just confirmed we found a real number
-                        has_dot = true;
-                    }
-                }
-                ++it;
+                res = checked_multiply(res, a);
+            }
+            b >>= 1;
+            if (b)
+            {
+                a = checked_multiply(a, a);
             }
-            auto tmp_str = std::string(tmp, it);
-            res.emplace_back(std::stod(tmp_str));
-            --it; // Iteration is pushed one step too far
-            continue;
         }
+        return res;
+    }
 
-        switch (*it)
+    auto integer_factorial(long long a)
+        -> long long
+    {
+        if (a < 0)
         {
-            case ')':
-                if (nmb_parenthesis == 0)
-                {
-                    throw evaluation_error("trying to close a non-opened parenthesis");
-                }
-                --nmb_parenthesis;
-                res.emplace_back(')');
-                break;
+            throw evaluation_error("factorial of a negative number");
+        }
+        if (a > 20)
+        {
+            // 21! does not fit in a long long
+            throw overflow_error();
+        }
+        long long res = 1;
+        for (long long i = 2 ; i <= a ; ++i)
+        {
+            res *= i;
+        }
+        return res;
+    }
 
-            case '(':
-                ++nmb_parenthesis;
-                res.emplace_back('(');
-                break;
+    template<int Op>
+    auto operation(long long a, long long b)
+        -> long long
+    {
+        switch (Op)
+        {
+            case op_t::ADD: return checked_add(a, b);               // +
+            case op_t::SUB: return checked_subtract(a, b);          // -
+            case op_t::MUL: return checked_multiply(a, b);          // *
+            case op_t::LT: return a < b;                            // <
+            case op_t::GT: return a > b;                            // >
+            case op_t::DIV: return checked_divide(a, b);            // /
+            case op_t::IDIV: return checked_divide(a, b);           // //
+            case op_t::MOD: return checked_modulo(a, b);            // %
+            case op_t::BAND: return a & b;                          // &
+            case op_t::BXOR: return a ^ b;                          // ^
+            case op_t::BOR: return a | b;                           // |
+            case op_t::EQ: return a == b;                           // =
+            case op_t::NE: return a != b;                           // != or <>
+            case op_t::GE: return a >= b;                           // >=
+            case op_t::LE: return a <= b;                           // <=
+            case op_t::AND: return a && b;                          // &&
+            case op_t::XOR: return (a && !b) || (b && !a);          // ^^
+            case op_t::OR: return a || b;                           // ||
+            case op_t::POW: return integer_power(a, b);             // **
+            case op_t::SPACE: return (a < b) ? -1 : (a != b);       // <=>
+            case op_t::LSHIFT: return checked_left_shift(a, b);     // <<
+            case op_t::RSHIFT: return a >> checked_shift_count(b);  // >>
+        }
+    }
 
-            case '+':
-                res.emplace_back(op_t::ADD);
-                break;
-            case '%':
-                res.emplace_back(op_t::MOD);
-                break;
-            case '~':
-                res.emplace_back(op_t::BNOT);
-                break;
-            case '=':
-                res.emplace_back(op_t::EQ);
-                break;
+    template<int Op>
+    auto operation(long long a)
+        -> long long
+    {
+        switch (Op)
+        {
+            case op_t::USUB: return checked_negate(a);              // -
+            case op_t::NOT: return !a;                              // ! (prefix)
+            case op_t::BNOT: return ~a;                             // ~
+            case op_t::FAC: return integer_factorial(a);            // ! (postfix)
+            case op_t::SQR: return checked_multiply(a, a);          // ** 2
+            case op_t::BOOL: return a != 0;                         // conversion
+        }
+    }
 
-            case '*': // * or **
-                if (it[1] == '*')
-                {
-                    res.emplace_back(op_t::POW);
-                    ++it;
-                }
-                else
-                {
-                    res.emplace_back(op_t::MUL);
-                }
-                break;
+    template<int Op>
+    auto operation(long long a, long long b, long long c)
+        -> long long
+    {
+        switch (Op)
+        {
+            case op_t::COND: return a ? b : c;  // ?:
+        }
+    }
 
-            case '&': // & or &&
-                if (it[1] == '&')
-                {
-                    res.emplace_back(op_t::AND);
-                    ++it;
-                }
-                else
-                {
-                    res.emplace_back(op_t::BAND);
-                }
-                break;
+    auto is_true(long long a)
+        -> bool
+    {
+        return a != 0;
+    }
 
-            case '|': // | or ||
-                if (it[1] == '*')
-                {
-                    res.emplace_back(op_t::OR);
-                    ++it;
-                }
-                else
-                {
-                    res.emplace_back(op_t::BOR);
-                }
-                break;
+    ////////////////////////////////////////////////////////////
+    // Fractions
 
-            case '^': // ^ or ^^
-                if (it[1] == '^')
-                {
-                    res.emplace_back(op_t::XOR);
-                    ++it;
-                }
-                else
-                {
-                    res.emplace_back(op_t::BXOR);
-                }
-                break;
+    // Positive denominator and no common factor, which
+    // keeps the terms small and makes comparisons easy
+    auto make_rational(long long num, long long den)
+        -> rational_t
+    {
+        checked_divisor(den);
 
-            case '/': // / or //
-                if (it[1] == '/')
-                {
-                    res.emplace_back(op_t::IDIV);
-                    ++it;
-                }
-                else
-                {
-                    res.emplace_back(op_t::DIV);
-                }
-                break;
+        // The magnitudes are unsigned to handle the
+        // smallest long long; their gcd is at most
+        // the magnitude of den, which is nonzero
+        auto magnitude = [](long long x)
+        {
+            return x < 0 ? 0ULL - static_cast<unsigned long long>(x)
+                         : static_cast<unsigned long long>(x);
+        };
+        unsigned long long a = magnitude(num);
+        unsigned long long b = magnitude(den);
+        while (b)
+        {
+            unsigned long long r = a % b;
+            a = b;
+            b = r;
+        }
+        if (a > 1)
+        {
+            num = static_cast<long long>(magnitude(num) / a) * (num < 0 ? -1 : 1);
+            den = static_cast<long long>(magnitude(den) / a) * (den < 0 ? -1 : 1);
+        }
+        if (den < 0)
+        {
+            num = checked_negate(num);
+            den = checked_negate(den);
+        }
+        return rational_t(num, den);
+    }
 
-            case '-': // - (unary or binary)
-                if (res.empty())
-                {
-                    res.emplace_back(op_t::USUB);
-                    break;
-                }
-                else
-                {
-                    const Token& t = res.back();
-                    if (is_operand(t)
-                        || is_postfix(t)
-                        || (t.type == elem_t::PARENTHESIS && t.par == ')'))
-                    {
-                        res.emplace_back(op_t::SUB);
-                    }
-                    else
-                    {
-                        res.emplace_back(op_t::USUB);
-                    }
-                    break;
-                }
+    auto add(const rational_t& a, const rational_t& b)
+        -> rational_t
+    {
+        return make_rational(checked_add(checked_multiply(a.numerator(), b.denominator()),
+                                         checked_multiply(b.numerator(), a.denominator())),
+                             checked_multiply(a.denominator(), b.denominator()));
+    }
 
-            case '<': // <, <=, <=>, << and <>
-                if (it[1] == '<')
-                {
-                    res.emplace_back(op_t::LSHIFT);
-                    ++it;
-                    break;
-                }
-                else if (it[1] == '>')
-                {
-                    res.emplace_back(op_t::NE);
-                    ++it;
-                    break;
-                }
-                else if (it[1] == '=')
-                {
-                    if (it[2] == '>')
-                    {
-                        res.emplace_back(op_t::SPACE);
-                        it += 2;
-                        break;
-                    }
-                    res.emplace_back(op_t::LE);
-                    ++it;
-                    break;
-                }
-                res.emplace_back(op_t::LT);
-                break;
+    auto subtract(const rational_t& a, const rational_t& b)
+        -> rational_t
+    {
+        return make_rational(checked_subtract(checked_multiply(a.numerator(), b.denominator()),
+                                              checked_multiply(b.numerator(), a.denominator())),
+                             checked_multiply(a.denominator(), b.denominator()));
+    }
 
-            case '>': // >, >= and >>
-                if (it[1] == '>')
-                {
-                    res.emplace_back(op_t::RSHIFT);
-                    ++it;
-                    break;
-                }
-                else if (it[1] == '=')
-                {
-                    res.emplace_back(op_t::GE);
-                    ++it;
-                    break;
-                }
-                res.emplace_back(op_t::GT);
-                break;
+    auto negate(const rational_t& a)
+        -> rational_t
+    {
+        return rational_t(checked_negate(a.numerator()), a.denominator());
+    }
 
-            case '!': // ! (prefix or postfix) and !=
-                if (it[1] == '=' && it[1] != '=')
-                {
-                    res.emplace_back(op_t::NE);
-                    break;
-                }
-                else
-                {
-                    const Token& t = res.back();
-                    if (is_operand(t)
-                        || is_postfix(t)
-                        || (t.type == elem_t::PARENTHESIS && t.par == ')'))
-                    {
-                        res.emplace_back(op_t::FAC);
-                        break;
-                    }
-                    res.emplace_back(op_t::NOT);
-                    break;
-                }
+    auto multiply(const rational_t& a, const rational_t& b)
+        -> rational_t
+    {
+        return make_rational(checked_multiply(a.numerator(), b.numerator()),
+                             checked_multiply(a.denominator(), b.denominator()));
+    }
 
-            default:
-                throw evaluation_error(eval_error_code::UNKNOWN_OPERATOR, *it);
-        }
+    auto divide(const rational_t& a, const rational_t& b)
+        -> rational_t
+    {
+        return make_rational(checked_multiply(a.numerator(), b.denominator()),
+                             checked_multiply(a.denominator(), b.numerator()));
     }
 
-    if (nmb_parenthesis)
+    // Sign of a - b
+    auto compare(const rational_t& a, const rational_t& b)
+        -> int
     {
-        throw evaluation_error("mismatched parenthesis in the expression");
+        long long lhs = checked_multiply(a.numerator(), b.denominator());
+        long long rhs = checked_multiply(b.numerator(), a.denominator());
+        return (lhs < rhs) ? -1 : (lhs != rhs);
     }
 
-    return res;
-}
+    auto is_true(const rational_t& a)
+        -> bool
+    {
+        return a.numerator() != 0;
+    }
 
-auto postfix(const std::vector<Token>& vec)
-    -> std::stack<Token>
-{
-    std::stack<Token> r, p;
+    // Integer value of a fraction, for the
+    // operators that only work on integers
+    auto as_integer(const rational_t& a)
+        -> long long
+    {
+        if (a.denominator() != 1)
+        {
+            throw evaluation_error("integer operator applied to a fraction");
+        }
+        return a.numerator();
+    }
 
-    for (const Token& token: vec)
+    auto truncate(const rational_t& a)
+        -> rational_t
     {
-        if (is_operand(token))
+        return rational_t(a.numerator() / a.denominator());
+    }
+
+    auto power(const rational_t& a, const rational_t& b)
+        -> rational_t
+    {
+        long long exponent = as_integer(b);
+        if (exponent < 0)
         {
-            r.push(token);
-            while (not p.empty() && is_prefix(p.top()))
-            {
-                r.push(p.top());
-                p.pop();
-            }
+            return divide(rational_t(1), power(a, rational_t(checked_negate(exponent))));
         }
-        else if (is_postfix(token))
+        return rational_t(integer_power(a.numerator(), exponent),
+                          integer_power(a.denominator(), exponent));
+    }
+
+    template<int Op>
+    auto operation(const rational_t& a, const rational_t& b)
+        -> rational_t
+    {
+        switch (Op)
         {
-            r.push(token);
+            case op_t::ADD: return add(a, b);                       // +
+            case op_t::SUB: return subtract(a, b);                  // -
+            case op_t::MUL: return multiply(a, b);                  // *
+            case op_t::LT: return rational_t(compare(a, b) < 0);    // <
+            case op_t::GT: return rational_t(compare(a, b) > 0);    // >
+            case op_t::DIV: return divide(a, b);                    // /
+            case op_t::IDIV: return truncate(divide(a, b));         // //
+            case op_t::MOD:                                         // %
+                return subtract(a, multiply(b, truncate(divide(a, b))));
+            case op_t::EQ: return rational_t(compare(a, b) == 0);   // =
+            case op_t::NE: return rational_t(compare(a, b) != 0);   // != or <>
+            case op_t::GE: return rational_t(compare(a, b) >= 0);   // >=
+            case op_t::LE: return rational_t(compare(a, b) <= 0);   // <=
+            case op_t::AND: return rational_t(is_true(a) && is_true(b));    // &&
+            case op_t::XOR: return rational_t(is_true(a) != is_true(b));    // ^^
+            case op_t::OR: return rational_t(is_true(a) || is_true(b));     // ||
+            case op_t::POW: return power(a, b);                     // **
+            case op_t::SPACE: return rational_t(compare(a, b));     // <=>
+
+            // Bitwise operators
+            case op_t::BAND:
+            case op_t::BXOR:
+            case op_t::BOR:
+            case op_t::LSHIFT:
+            case op_t::RSHIFT:
+                return rational_t(operation<Op>(as_integer(a), as_integer(b)));
         }
-        else if (is_operator(token))
+    }
+
+    template<int Op>
+    auto operation(const rational_t& a)
+        -> rational_t
+    {
+        switch (Op)
         {
-            while (not p.empty() && is_operator(p.top())
-                  && (priority(token) <= priority(p.top())))
-            {
-                r.push(p.top());
-                p.pop();
-            }
-            p.push(token);
+            case op_t::USUB: return negate(a);                                      // -
+            case op_t::NOT: return rational_t(not is_true(a));                      // ! (prefix)
+            case op_t::BNOT: return rational_t(~as_integer(a));                     // ~
+            case op_t::FAC: return rational_t(integer_factorial(as_integer(a)));    // ! (postfix)
+            case op_t::SQR: return multiply(a, a);                                  // ** 2
+            case op_t::BOOL: return rational_t(is_true(a));                         // conversion
         }
-        else if (is_prefix(token) || token.par == '(')
+    }
+
+    template<int Op>
+    auto operation(const rational_t& a, const rational_t& b, const rational_t& c)
+        -> rational_t
+    {
+        switch (Op)
         {
-            p.push(token);
+            case op_t::COND: return is_true(a) ? b : c; // ?:
         }
-        else // if token.par == ')'
+    }
+
+    ////////////////////////////////////////////////////////////
+    // Literals
+
+    template<typename Number>
+    auto literal_value(const literal& lit)
+        -> Number;
+
+    template<>
+    auto literal_value<long long>(const literal& lit)
+        -> long long
+    {
+        long long res = 0;
+        for (const char* it = lit.first ; it != lit.second ; ++it)
         {
-            while (not p.empty() && p.top().par != '(')
+            if (*it == '.')
             {
-                r.push(p.top());
-                p.pop();
+                throw evaluation_error("non-integer literal in an integer expression");
             }
-            p.pop();
-            while (not p.empty() && is_prefix(p.top()))
+            int digit = *it - '0';
+            if (res > (std::numeric_limits<long long>::max() - digit) / 10)
             {
-                r.push(p.top());
-                p.pop();
+                throw evaluation_error("literal too big: " + std::string(lit.first, lit.second));
             }
+            res = res * 10 + digit;
         }
+        return res;
     }
 
-    while (not r.empty())
-    {
-        p.push(r.top());
-        r.pop();
-    }
-    return p;
-}
-
-auto eval_postfix(std::stack<Token>&& st)
-    -> double
-{
-    Token x, y, e;
-    std::stack<Token> operands;
-
-    while (not st.empty())
+    template<>
+    auto literal_value<rational_t>(const literal& lit)
+        -> rational_t
     {
-        e = st.top();
-        st.pop();
-        if (is_operand(e))
-        {
-            operands.push(e);
-        }
-        else if (is_operator(e))
+        // The number is read as an integer divided
+        // by the power of ten of its decimals
+        long long num = 0;
+        long long den = 1;
+        bool has_dot = false;
+        for (const char* it = lit.first ; it != lit.second ; ++it)
         {
-            if (operands.size() < 2)
+            if (*it == '.')
             {
-                throw evaluation_error(eval_error_code::NOT_ENOUGH_OPERANDS, op_str[e.op]);
+                has_dot = true;
+                continue;
             }
-            x = operands.top();
-            operands.pop();
-            y = operands.top();
-            operands.pop();
-            operands.push(operation(y.data, x.data, e.op));
-        }
-        else // if (is_prefix(token) || is_postfix(token))
-        {
-            if (operands.empty())
+            int digit = *it - '0';
+            if (num > (std::numeric_limits<long long>::max() - digit) / 10
+                || (has_dot && den > std::numeric_limits<long long>::max() / 10))
+            {
+                throw evaluation_error("literal too big: " + std::string(lit.first, lit.second));
+            }
+            num = num * 10 + digit;
+            if (has_dot)
             {
-                throw evaluation_error(eval_error_code::NOT_ENOUGH_OPERANDS, op_str[e.op]);
+                den *= 10;
             }
-            x = operands.top();
-            operands.pop();
-            operands.push(operation(x.data, e.op));
         }
+        return make_rational(num, den);
     }
-    return operands.top().data;
-}
 
-////////////////////////////////////////////////////////////
-// Miscellaneous functions
-////////////////////////////////////////////////////////////
-
-auto priority(const Token& token)
-    -> int
-{
-    return _priority[token.op];
-}
-
-auto operation(double a, double b, op_t op)
-    -> Token
-{
-    Token res;
-    res.type = elem_t::OPERAND;
-
-    switch (op)
+    ////////////////////////////////////////////////////////////
+    // Evaluation
+
+    /**
+     * Values stack used to evaluate an expression
+     * exactly, with integers or fractions.
+     */
+    template<typename Number>
+    struct exact_stack
     {
-        case op_t::ADD: res.data = a + b; break;                     // +
-        case op_t::SUB: res.data = a - b; break;                     // -
-        case op_t::MUL: res.data = a * b; break;                     // *
-        case op_t::LT: res.data = a < b; break;                      // <
-        case op_t::GT: res.data = a > b; break;                      // >
-        case op_t::DIV: res.data = a / b; break;                     // /
-        case op_t::IDIV: res.data = (int) a / (int) b; break;        // //
-        case op_t::MOD: res.data = (int) a % (int) b; break;         // %
-        case op_t::BAND: res.data = (int) a & (int) b; break;        // &
-        case op_t::BXOR: res.data = (int) a ^ (int) b; break;        // ^
-        case op_t::BOR: res.data = (int) a | (int) b; break;         // |
-        case op_t::EQ: res.data = (a == b); break;                   // ==
-        case op_t::NE: res.data = (a != b); break;                   // != or <>
-        case op_t::GE: res.data = (a >= b); break;                   // >=
-        case op_t::LE: res.data = (a <= b); break;                   // <=
-        case op_t::AND: res.data = (a && b); break;                  // &&
-        case op_t::XOR: res.data = (a && !b) || (b && !a); break;    // ^^
-        case op_t::OR: res.data = (a || b); break;                   // ||
-        case op_t::POW: res.data = std::pow(a, b); break;            // **
-        case op_t::SPACE: res.data = (a < b) ? -1 : (a != b); break; // <=>
-        case op_t::LSHIFT: res.data = (int) a << (int) b; break;     // <<
-        case op_t::RSHIFT: res.data = (int) a >> (int) b; break;     // >>
+        Number* top;    // One past the top of the stack
 
-        // Should never happen
-        default:
-            throw evaluation_error();
-    }
-    return res;
-}
+        template<int Op>
+        auto binary()
+            -> void
+        {
+            --top;
+            top[-1] = operation<Op>(top[-1], top[0]);
+        }
 
-auto operation(double a, op_t op)
-    -> Token
-{
-    Token res;
-    res.type = elem_t::OPERAND;
+        template<int Op>
+        auto unary()
+            -> void
+        {
+            top[-1] = operation<Op>(top[-1]);
+        }
 
-    switch (op)
-    {
-        case op_t::USUB: res.data = -a; break;                                  // -
-        case op_t::NOT: res.data = !a; break;                                   // ! (prefix)
-        case op_t::BNOT: res.data = ~ (int) a; break;                           // ~
-        case op_t::FAC: res.data = math::factorial((unsigned int) a); break;    // ! (postfix)
+        template<int Op>
+        auto ternary()
+            -> void
+        {
+            top -= 2;
+            top[-1] = operation<Op>(top[-1], top[0], top[1]);
+        }
+    };
 
-        // Should never happen
-        default:
-            throw evaluation_error();
-    }
-    return res;
-}
+    template<typename Number>
+    auto evaluate_exact(const std::string& expr)
+        -> Number
+    {
+        thread_local details::program prog;
+        thread_local std::vector<literal> literals;
+        thread_local std::vector<std::string> no_variables;
+
+        // The literals are kept as text by the parser
+        // since a double could not represent all of them
+        parse(expr.data(), expr.data() + expr.size(),
+              no_variables, false, true, prog, &literals);
+
+        std::vector<Number> constants;
+        constants.reserve(literals.size());
+        for (const auto& lit: literals)
+        {
+            constants.push_back(literal_value<Number>(lit));
+        }
 
-////////////////////////////////////////////////////////////
-// Type checking functions
-////////////////////////////////////////////////////////////
+        std::vector<Number> stack(prog.stack_size);
+        exact_stack<Number> st = { stack.data() };
 
-auto is_operand(const Token& token)
-    -> bool
-{
-    return token.type == elem_t::OPERAND;
+        const details::instruction* first = prog.code.data();
+        const details::instruction* last = first + prog.code.size();
+        for (auto it = first ; it != last ; ++it)
+        {
+            switch (it->op)
+            {
+                case op_t::PUSH:
+                    *st.top++ = constants[it->index];
+                    break;
+                // The jumps land right before the target
+                // since the loop increments the iterator
+                case op_t::JUMP:
+                    it = first + it->index - 1;
+                    break;
+                case op_t::JUMP_IF_FALSE:
+                    if (not is_true(*--st.top))
+                    {
+                        it = first + it->index - 1;
+                    }
+                    break;
+                case op_t::AND_JUMP:
+                    if (not is_true(st.top[-1]))
+                    {
+                        st.top[-1] = Number(0);
+                        it = first + it->index - 1;
+                    }
+                    else
+                    {
+                        --st.top;
+                    }
+                    break;
+                case op_t::OR_JUMP:
+                    if (is_true(st.top[-1]))
+                    {
+                        st.top[-1] = Number(1);
+                        it = first + it->index - 1;
+                    }
+                    else
+                    {
+                        --st.top;
+                    }
+                    break;
+                case op_t::CALL1:
+                case op_t::CALL2:
+                    throw evaluation_error("built-in functions are not available in exact evaluation");
+                default:
+                    dispatch(it->op, st);
+            }
+        }
+        return st.top[-1];
+    }
 }
 
-auto is_operator(const Token& token)
-    -> bool
+template<>
+auto evaluate<double>(const std::string& expr)
+    -> double
 {
-    return token.type == elem_t::OPERATOR;
+    return evaluate(expr);
 }
 
-auto is_prefix(const Token& token)
-    -> bool
+template<>
+auto evaluate<long long>(const std::string& expr)
+    -> long long
 {
-    return token.type == elem_t::PREFIX;
+    return evaluate_exact<long long>(expr);
 }
 
-auto is_postfix(const Token& token)
-    -> bool
+template<>
+auto evaluate<rational<long long>>(const std::string& expr)
+    -> rational<long long>
 {
-    return token.type == elem_t::POSTFIX;
+    return evaluate_exact<rational_t>(expr);
 }
 
 ////////////////////////////////////////////////////////////
@@ -704,6 +2989,15 @@ evaluation_error::evaluation_error(eval_error_code e, const std::string& arg)
         case eval_error_code::NOT_ENOUGH_OPERANDS:
             oss << "not enough operands for operator '" << arg << "'.";
             break;
+        case eval_error_code::UNKNOWN_VARIABLE:
+            oss << "unknown variable '" << arg << "' in the expression";
+            break;
+        case eval_error_code::UNKNOWN_FUNCTION:
+            oss << "unknown function '" << arg << "' in the expression";
+            break;
+        case eval_error_code::WRONG_NUMBER_OF_ARGUMENTS:
+            oss << "wrong number of arguments for function '" << arg << "'";
+            break;
         default:
             oss << "unknown error in the expression";
             break;
@@ -0,0 +1,367 @@
+/*
+ * Copyright (C) 2011-2014 Morwenn
+ *
+ * POLDER is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * POLDER is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program. If not,
+ * see <http://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <thread>
+#include <utility>
+#include <POLDER/formula_graph.h>
+
+
+namespace polder
+{
+
+formula_graph::formula_graph(std::size_t nb_threads):
+    _nb_threads(nb_threads ? nb_threads : std::thread::hardware_concurrency())
+{
+    if (_nb_threads == 0)
+    {
+        _nb_threads = 1;
+    }
+}
+
+auto formula_graph::define(const std::string& name, const std::string& expr)
+    -> void
+{
+    expression formula = compile(expr);
+
+    // Check for cycles before changing anything; names
+    // that do not exist yet can not create a cycle
+    auto it = _index.find(name);
+    for (const auto& var: formula.variables())
+    {
+        if (var == name)
+        {
+            throw evaluation_error("formula '" + name + "' depends on itself");
+        }
+        auto dep = _index.find(var);
+        if (it != _index.end() && dep != _index.end()
+            && reaches(it->second, dep->second))
+        {
+            throw evaluation_error("formula '" + name + "' depends on itself through '" + var + "'");
+        }
+    }
+
+    std::size_t id = find_or_create(name);
+    std::vector<std::size_t> dependencies;
+    for (const auto& var: formula.variables())
+    {
+        dependencies.push_back(find_or_create(var));
+    }
+
+    node& n = _nodes[id];
+    n.is_formula = true;
+    n.formula = std::move(formula);
+    set_dependencies(id, std::move(dependencies));
+    mark_dirty(id);
+}
+
+auto formula_graph::set(const std::string& name, double value)
+    -> void
+{
+    std::size_t id = find_or_create(name);
+    node& n = _nodes[id];
+    if (n.is_formula)
+    {
+        n.is_formula = false;
+        n.formula = expression();
+        set_dependencies(id, {});
+    }
+    else if (n.value == value)
+    {
+        return;
+    }
+
+    // The input itself does not need to be computed,
+    // but its dependents do
+    mark_dirty(id);
+    n.value = value;
+    n.dirty = false;
+}
+
+auto formula_graph::value(const std::string& name)
+    -> double
+{
+    auto it = _index.find(name);
+    if (it == _index.end())
+    {
+        throw evaluation_error("unknown formula '" + name + "'");
+    }
+    recalculate();
+    return _nodes[it->second].value;
+}
+
+auto formula_graph::contains(const std::string& name) const
+    -> bool
+{
+    return _index.find(name) != _index.end();
+}
+
+auto formula_graph::recalculate()
+    -> void
+{
+    // The inputs set since the last computation
+    // are in the list but are not dirty anymore
+    _dirty.erase(std::remove_if(_dirty.begin(), _dirty.end(),
+                                [&](std::size_t id)
+                                {
+                                    if (_nodes[id].dirty)
+                                    {
+                                        return false;
+                                    }
+                                    _nodes[id].queued = false;
+                                    return true;
+                                }),
+                 _dirty.end());
+    if (_dirty.empty())
+    {
+        return;
+    }
+
+    // Topological order of the dirty nodes: a node
+    // is ready once its dirty dependencies are done
+    for (std::size_t id: _dirty)
+    {
+        node& n = _nodes[id];
+        n.pending = 0;
+        for (std::size_t dep: n.dependencies)
+        {
+            n.pending += _nodes[dep].dirty;
+        }
+    }
+
+    std::vector<std::size_t> order;
+    order.reserve(_dirty.size());
+    for (std::size_t id: _dirty)
+    {
+        if (_nodes[id].pending == 0)
+        {
+            order.push_back(id);
+        }
+    }
+    for (std::size_t i = 0 ; i < order.size() ; ++i)
+    {
+        for (std::size_t dep: _nodes[order[i]].dependents)
+        {
+            if (--_nodes[dep].pending == 0)
+            {
+                order.push_back(dep);
+            }
+        }
+    }
+
+    if (_nb_threads == 1 || order.size() < 2)
+    {
+        std::vector<double> args;
+        for (std::size_t id: order)
+        {
+            compute(id, args);
+        }
+        clear_dirty();
+        return;
+    }
+
+    // Split the dirty nodes into groups that do not
+    // depend on each other with a union-find
+    for (std::size_t id: order)
+    {
+        _nodes[id].parent = id;
+    }
+    auto root = [&](std::size_t id)
+    {
+        while (_nodes[id].parent != id)
+        {
+            id = _nodes[id].parent = _nodes[_nodes[id].parent].parent;
+        }
+        return id;
+    };
+    for (std::size_t id: order)
+    {
+        for (std::size_t dep: _nodes[id].dependencies)
+        {
+            if (_nodes[dep].dirty)
+            {
+                _nodes[root(id)].parent = root(dep);
+            }
+        }
+    }
+
+    // Keep the topological order within every group;
+    // the pending counters are reused as group indices
+    std::vector<std::vector<std::size_t>> groups;
+    for (std::size_t id: order)
+    {
+        node& r = _nodes[root(id)];
+        if (r.pending == 0)
+        {
+            groups.emplace_back();
+            r.pending = groups.size();
+        }
+        groups[r.pending - 1].push_back(id);
+    }
+
+    // Biggest groups first for a better balance
+    std::sort(groups.begin(), groups.end(),
+              [](const std::vector<std::size_t>& lhs, const std::vector<std::size_t>& rhs)
+              {
+                  return lhs.size() > rhs.size();
+              });
+
+    std::atomic<std::size_t> next_group(0);
+    auto work = [&]
+    {
+        std::vector<double> args;
+        for (auto i = next_group++ ; i < groups.size() ; i = next_group++)
+        {
+            for (std::size_t id: groups[i])
+            {
+                compute(id, args);
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    auto nb_threads = std::min(_nb_threads, groups.size());
+    for (std::size_t i = 1 ; i < nb_threads ; ++i)
+    {
+        threads.emplace_back(work);
+    }
+    work();
+    for (auto& thread: threads)
+    {
+        thread.join();
+    }
+    clear_dirty();
+}
+
+auto formula_graph::find_or_create(const std::string& name)
+    -> std::size_t
+{
+    auto it = _index.find(name);
+    if (it != _index.end())
+    {
+        return it->second;
+    }
+
+    node n;
+    n.name = name;
+    n.value = std::numeric_limits<double>::quiet_NaN();
+    _nodes.push_back(std::move(n));
+    _index.emplace(name, _nodes.size() - 1);
+    return _nodes.size() - 1;
+}
+
+auto formula_graph::reaches(std::size_t from, std::size_t to) const
+    -> bool
+{
+    std::vector<bool> visited(_nodes.size());
+    std::vector<std::size_t> stack = { from };
+    while (not stack.empty())
+    {
+        std::size_t id = stack.back();
+        stack.pop_back();
+        if (id == to)
+        {
+            return true;
+        }
+        if (visited[id])
+        {
+            continue;
+        }
+        visited[id] = true;
+        for (std::size_t dep: _nodes[id].dependents)
+        {
+            stack.push_back(dep);
+        }
+    }
+    return false;
+}
+
+auto formula_graph::set_dependencies(std::size_t id, std::vector<std::size_t>&& dependencies)
+    -> void
+{
+    for (std::size_t dep: _nodes[id].dependencies)
+    {
+        auto& dependents = _nodes[dep].dependents;
+        dependents.erase(std::find(dependents.begin(), dependents.end(), id));
+    }
+
+    // A formula may use the same name several
+    // times but only has one slot per name
+    for (std::size_t dep: dependencies)
+    {
+        _nodes[dep].dependents.push_back(id);
+    }
+    _nodes[id].dependencies = std::move(dependencies);
+}
+
+auto formula_graph::mark_dirty(std::size_t id)
+    -> void
+{
+    std::vector<std::size_t> stack = { id };
+    while (not stack.empty())
+    {
+        std::size_t current = stack.back();
+        stack.pop_back();
+        node& n = _nodes[current];
+        if (n.dirty)
+        {
+            continue;
+        }
+        n.dirty = true;
+        if (not n.queued)
+        {
+            // An input set since the last computation
+            // is still in the list, but not dirty
+            n.queued = true;
+            _dirty.push_back(current);
+        }
+        for (std::size_t dep: n.dependents)
+        {
+            stack.push_back(dep);
+        }
+    }
+}
+
+auto formula_graph::clear_dirty()
+    -> void
+{
+    for (std::size_t id: _dirty)
+    {
+        _nodes[id].queued = false;
+    }
+    _dirty.clear();
+}
+
+auto formula_graph::compute(std::size_t id, std::vector<double>& args)
+    -> void
+{
+    node& n = _nodes[id];
+    if (n.is_formula)
+    {
+        args.clear();
+        for (std::size_t dep: n.dependencies)
+        {
+            args.push_back(_nodes[dep].value);
+        }
+        n.value = n.formula(args.data());
+    }
+    n.dirty = false;
+}
+
+} // namespace polder
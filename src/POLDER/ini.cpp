@@ -15,48 +15,299 @@
  * License along with this program. If not,
  * see <http://www.gnu.org/licenses/>.
  */
+#include <algorithm>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <limits>
+#include <locale>
 #include <fstream>
+#include <iterator>
+#include <random>
 #include <sstream>
+#include <stdexcept>
+#include <type_traits>
 #include <utility>
 #include <POLDER/ini.h>
-#include <POLDER/io.h>
-#include <POLDER/string.h>
 #include <POLDER/stype.h>
 
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifndef POLDER_OS_WINDOWS
+    #include <cerrno>
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <unistd.h>
+#endif
+
+#ifdef POLDER_OS_LINUX
+    #include <poll.h>
+    #include <sys/inotify.h>
+#endif
+
+#if defined(__SSE2__) && defined(__GNUC__)
+    #define POLDER_INI_SSE2
+    #include <emmintrin.h>
+#endif
+
 
 namespace polder
 {
 namespace ini
 {
 
-using namespace string;
+////////////////////////////////////////////////////////////
+// Numbers
+////////////////////////////////////////////////////////////
 
-
-// INI-specific elements
 namespace
 {
-    /**
-* Return a string without comments
-*/
-    char* strnorm(const char* str, Dialect dialect)
+    auto is_space(char c)
+        -> bool
+    {
+        return c == ' ' || c == '\t' || c == '\r' || c == '\n'
+            || c == '\v' || c == '\f';
+    }
+
+    auto is_digit(char c)
+        -> bool
+    {
+        return c >= '0' && c <= '9';
+    }
+
+    /*
+     * The number parsers do not depend on the locale and
+     * read [first, last) in place. Like the std::sto*
+     * functions, they skip the leading spaces, ignore what
+     * follows the number, and throw std::invalid_argument
+     * or std::out_of_range.
+     */
+
+    template<typename Integer>
+    auto parse_integer(const char* first, const char* last)
+        -> Integer
     {
-        char* new_str = new char[strlen(str)];
-        int count = -1, i = -1;
-        while (str[++i])
+        using Unsigned = typename std::make_unsigned<Integer>::type;
+
+        while (first != last && is_space(*first))
+        {
+            ++first;
+        }
+        bool negative = false;
+        if (first != last && (*first == '+' || *first == '-'))
+        {
+            negative = *first++ == '-';
+        }
+        if (first == last || not is_digit(*first))
+        {
+            throw std::invalid_argument("ini: not an integer");
+        }
+
+        const Unsigned max = std::numeric_limits<Unsigned>::max();
+        Unsigned value = 0;
+        bool overflow = false;
+        for (; first != last && is_digit(*first) ; ++first)
         {
-            if (str[i] == dialect.lineterminator
-                || str[i] == dialect.commentchar)
+            unsigned digit = *first - '0';
+            overflow |= value > (max - digit) / 10;
+            value = value * 10 + digit;
+        }
+
+        if (std::is_signed<Integer>::value)
+        {
+            Unsigned limit = static_cast<Unsigned>(std::numeric_limits<Integer>::max()) + negative;
+            if (overflow || value > limit)
             {
-                count -= 2;
-                break;
+                throw std::out_of_range("ini: integer out of range");
+            }
+            if (negative && value != 0)
+            {
+                return -static_cast<Integer>(value - 1) - 1;
+            }
+            return static_cast<Integer>(value);
+        }
+
+        // Negative values wrap around, like strtoul
+        if (overflow)
+        {
+            throw std::out_of_range("ini: integer out of range");
+        }
+        return static_cast<Integer>(negative ? Unsigned(0) - value : value);
+    }
+
+    // Case-insensitive comparison with a lowercase word
+    auto starts_with_word(const char* first, const char* last, const char* word)
+        -> bool
+    {
+        for (; *word ; ++first, ++word)
+        {
+            if (first == last || (*first | 0x20) != *word)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /*
+     * Decimal numbers with at most 19 significant digits
+     * and a small exponent are exactly representable as a
+     * mantissa and a power of 10, and the result of their
+     * multiplication or division is correctly rounded; the
+     * other ones are left to the standard library, through
+     * a stream using the classic locale.
+     */
+    template<typename Float>
+    auto parse_float(const char* first, const char* last)
+        -> Float
+    {
+        static const long double powers_of_10[] = {
+            1e0L, 1e1L, 1e2L, 1e3L, 1e4L, 1e5L, 1e6L, 1e7L, 1e8L, 1e9L,
+            1e10L, 1e11L, 1e12L, 1e13L, 1e14L, 1e15L, 1e16L, 1e17L, 1e18L,
+            1e19L, 1e20L, 1e21L, 1e22L, 1e23L, 1e24L, 1e25L, 1e26L, 1e27L
+        };
+        // Greatest n such as 5**n fits in the mantissa
+        const int digits = std::numeric_limits<Float>::digits;
+        const int max_exact_power = (digits >= 64) ? 27 : (digits >= 53) ? 22 : 10;
+
+        while (first != last && is_space(*first))
+        {
+            ++first;
+        }
+        const char* number_first = first;
+        bool negative = false;
+        if (first != last && (*first == '+' || *first == '-'))
+        {
+            negative = *first++ == '-';
+        }
+
+        if (starts_with_word(first, last, "inf"))
+        {
+            Float inf = std::numeric_limits<Float>::infinity();
+            return negative ? -inf : inf;
+        }
+        if (starts_with_word(first, last, "nan"))
+        {
+            return std::numeric_limits<Float>::quiet_NaN();
+        }
+
+        unsigned long long mantissa = 0;
+        int nb_digits = 0;          // Significant digits read
+        int exponent = 0;
+        bool any_digit = false;
+        bool exact = true;
+        auto read_digit = [&](char c)
+        {
+            any_digit = true;
+            if (nb_digits == 19)
+            {
+                exact &= (c == '0');
+                return false;
+            }
+            mantissa = mantissa * 10 + (c - '0');
+            nb_digits += (mantissa != 0);
+            return true;
+        };
+
+        for (; first != last && is_digit(*first) ; ++first)
+        {
+            // Digits that do not fit only scale the number
+            exponent += not read_digit(*first);
+        }
+        if (first != last && *first == '.')
+        {
+            for (++first ; first != last && is_digit(*first) ; ++first)
+            {
+                exponent -= read_digit(*first);
+            }
+        }
+        if (not any_digit)
+        {
+            throw std::invalid_argument("ini: not a number");
+        }
+
+        if (first != last && (*first == 'e' || *first == 'E'))
+        {
+            const char* exp_first = first + 1;
+            bool exp_negative = false;
+            if (exp_first != last && (*exp_first == '+' || *exp_first == '-'))
+            {
+                exp_negative = *exp_first++ == '-';
+            }
+            if (exp_first != last && is_digit(*exp_first))
+            {
+                int exp = 0;
+                for (; exp_first != last && is_digit(*exp_first) ; ++exp_first)
+                {
+                    // Saturated, big enough to overflow anyway
+                    exp = std::min(exp * 10 + (*exp_first - '0'), 100000);
+                }
+                exponent += exp_negative ? -exp : exp;
+                first = exp_first;
+            }
+        }
+
+        bool fits = digits >= 64 || mantissa < (1ULL << std::min(digits, 63));
+        if (exact && fits && exponent >= -max_exact_power && exponent <= max_exact_power)
+        {
+            Float value = static_cast<Float>(mantissa);
+            if (exponent < 0)
+            {
+                value /= static_cast<Float>(powers_of_10[-exponent]);
+            }
+            else
+            {
+                value *= static_cast<Float>(powers_of_10[exponent]);
             }
-            new_str[++count] = str[i];
+            return negative ? -value : value;
+        }
+
+        std::istringstream stream(std::string(number_first, first));
+        stream.imbue(std::locale::classic());
+        Float value;
+        if (not (stream >> value))
+        {
+            throw std::out_of_range("ini: number out of range");
         }
-        new_str[count] = '\0';
-        return stripped(new_str);
+        return value;
+    }
+
+    template<typename T>
+    auto convert(const char* first, const char* last, std::true_type)
+        -> T
+    {
+        return parse_integer<T>(first, last);
+    }
+
+    template<typename T>
+    auto convert(const char* first, const char* last, std::false_type)
+        -> T
+    {
+        return parse_float<T>(first, last);
+    }
+
+    // Value of [first, last) converted to one of
+    // the types supported by Element
+    template<typename T>
+    auto convert(const char* first, const char* last)
+        -> T
+    {
+        return convert<T>(first, last, std::is_integral<T>{});
+    }
+
+    template<>
+    auto convert<std::string>(const char* first, const char* last)
+        -> std::string
+    {
+        return std::string(first, last);
+    }
+
+    template<typename T>
+    auto convert(const std::string& str)
+        -> T
+    {
+        return convert<T>(str.data(), str.data() + str.size());
     }
 }
 
@@ -76,821 +327,2794 @@ Element::operator std::string() const
 
 Element::operator int() const
 {
-    return std::stoi(_data);
+    return convert<int>(_data);
 }
 
 Element::operator long() const
 {
-    return std::stol(_data);
+    return convert<long>(_data);
 }
 
 Element::operator long long() const
 {
-    return std::stoll(_data);
+    return convert<long long>(_data);
 }
 
 Element::operator unsigned() const
 {
-    return std::stoi(_data);
+    return convert<unsigned>(_data);
 }
 
 Element::operator unsigned long() const
 {
-    return std::stoul(_data);
+    return convert<unsigned long>(_data);
 }
 
 Element::operator unsigned long long() const
 {
-    return std::stoull(_data);
+    return convert<unsigned long long>(_data);
 }
 
 Element::operator float() const
 {
-    return std::stof(_data);
+    return convert<float>(_data);
 }
 
 Element::operator double() const
 {
-    return std::stod(_data);
+    return convert<double>(_data);
 }
 
 Element::operator long double() const
 {
-    return std::stold(_data);
+    return convert<long double>(_data);
 }
 
-/**
-* Return whether the given section exists or not
-*/
-auto section_exists(const std::string& fname, const std::string& section, Dialect dialect)
-    -> bool
-{
-    // Open the file
-    std::ifstream file(fname);
-    if (not file)
-    {
-        throw Error(std::string(__FUNCTION__) + ": " + fname + ": can not open file");
-    }
+////////////////////////////////////////////////////////////
+// Document
+////////////////////////////////////////////////////////////
 
-    auto searched = "[" + section + "]";
-    std::string line;
-    // Read the lines
-    while (getline(file, line))
+namespace
+{
+    // Removes the spaces around [first, last)
+    auto trim(const char*& first, const char*& last)
+        -> void
     {
-        lstrip(line);
-        if (line.substr(0, searched.size()) == searched)
+        while (first != last && is_space(*first))
         {
-            // The section has been found
-            file.close();
-            return true;
+            ++first;
+        }
+        while (last != first && is_space(last[-1]))
+        {
+            --last;
         }
     }
 
-    // The section has not been found
-    file.close();
-    return false;
-}
-
-
-/**
-* Return whether the given key exists or not
-*/
-auto key_exists(const std::string& fname, const std::string& section, const std::string& key, Dialect dialect)
-    -> bool
-{
-    // Open the file
-    std::ifstream file(fname);
-    if (not file)
+    enum struct LineKind
     {
-        throw Error(std::string(__FUNCTION__) + ": " + fname + ": can not open file");
+        EMPTY,      // Blank line or comment
+        SECTION,    // [section]
+        BROKEN,     // [ without ]
+        KEY,        // key = value
+        OTHER       // Line without a delimiter
+    };
+
+    // Parts of a line, without the spaces around them
+    struct LineInfo
+    {
+        LineKind kind;
+        const char* name_first;     // Section name or key
+        const char* name_last;
+        const char* value_first;    // Value of a key
+        const char* value_last;
+    };
+
+    auto find_char(const char* first, const char* last, char c)
+        -> const char*
+    {
+        return static_cast<const char*>(std::memchr(first, c, last - first));
     }
 
-    auto searched = "[" + section + "]";
-    bool section_found = false;
-    std::string line;
-    // Read the lines
-    while (getline(file, line))
+    // The characters are searched with memchr,
+    // which is vectorized by the C libraries
+    auto parse_line(const char* first, const char* last, const Dialect& dialect)
+        -> LineInfo
     {
-        strip(line);
-        if (not section_found)
+        LineInfo res = { LineKind::EMPTY, nullptr, nullptr, nullptr, nullptr };
+        trim(first, last);
+        if (first == last || *first == dialect.commentchar)
+        {
+            return res;
+        }
+
+        if (*first == '[')
         {
-            // Search the section
-            if (line.substr(0, searched.size()) == searched)
+            // Everything after the closing bracket is ignored
+            const char* close = find_char(first, last, ']');
+            if (close == nullptr)
             {
-                section_found = true;
+                res.kind = LineKind::BROKEN;
+                return res;
             }
+            res.kind = LineKind::SECTION;
+            res.name_first = first + 1;
+            res.name_last = close;
+            return res;
+        }
+
+        const char* delim = find_char(first, last, dialect.delimiter);
+        if (delim == nullptr)
+        {
+            res.kind = LineKind::OTHER;
+            return res;
         }
-        else // If the given section exists
+
+        res.kind = LineKind::KEY;
+        res.name_first = first;
+        res.name_last = delim;
+        trim(res.name_first, res.name_last);
+
+        res.value_first = delim + 1;
+        res.value_last = find_char(res.value_first, last, dialect.commentchar);
+        if (res.value_last == nullptr)
         {
-            if (line[0] == '[')
+            res.value_last = last;
+        }
+        trim(res.value_first, res.value_last);
+        return res;
+    }
+
+    /*
+     * Line scanners: next_line parses the line starting at
+     * first and returns its terminator, or nullptr when the
+     * line has no terminator before last.
+     */
+
+    // Any dialect, the characters are searched with memchr
+    class RuntimeDialect
+    {
+        public:
+
+            explicit RuntimeDialect(const Dialect& dialect):
+                _dialect(dialect)
+            {}
+
+            auto dialect() const
+                -> const Dialect&
             {
-                // We reached another section
-                file.close();
-                return false;
+                return _dialect;
             }
-            else if (line[0] != dialect.commentchar && line[0] != '\0') // We check whether the key is the good one
+
+            auto next_line(const char* first, const char* last, LineInfo& line) const
+                -> const char*
             {
-                int i = -1;
-                while (line[++i] != '\0'
-                       && line[i] != dialect.lineterminator
-                       && line[i] != dialect.delimiter);
-                if (line[i] == dialect.delimiter)
+                const char* line_last = find_char(first, last, _dialect.lineterminator);
+                if (line_last != nullptr)
                 {
-                    if (key == stripped(line.substr(0, i)))
-                    {
-                        // The key has been found
-                        file.close();
-                        return true;
-                    }
+                    line = parse_line(first, line_last, _dialect);
                 }
-                // Else, there is no key, strange...
+                return line_last;
             }
-        }
-    }
-
-    // The has not been found
-    file.close();
-    return false;
-}
-
-
-/**
-* Read the string value corresponding to the given key
-*/
-auto read(const std::string& fname, const std::string& section, const std::string& key, const std::string& default_value, Dialect dialect)
-    -> Element
-{
-    // Open the file
-    std::ifstream file(fname);
-    if (not file)
-    {
-        throw Error(std::string(__FUNCTION__) + ": " + fname + ": can not open file");
-    }
 
-    auto searched = "[" + section + "]";
-    bool section_found = false;
-    std::string line;
-    // Read the lines
-    while (getline(file, line))
+        private:
+
+            Dialect _dialect;
+    };
+
+    /*
+     * Single pass over a line of a common dialect, whose
+     * characters are known at compile time. Returns the line
+     * terminator, or nullptr if there is none before last,
+     * and sets delim to the first delimiter of the line and
+     * comment to the first comment character after it, or to
+     * nullptr if there are none. With SSE2, sixteen bytes are
+     * compared at once to the three characters.
+     */
+    template<char Delimiter, char CommentChar>
+    auto split_line(const char* first, const char* last,
+                    const char*& delim, const char*& comment)
+        -> const char*
     {
-        strip(line);
-        if (not section_found)
+        delim = nullptr;
+        comment = nullptr;
+#ifdef POLDER_INI_SSE2
+        const __m128i terminators = _mm_set1_epi8('\n');
+        const __m128i delimiters = _mm_set1_epi8(Delimiter);
+        const __m128i comments = _mm_set1_epi8(CommentChar);
+        for (; last - first >= 16 ; first += 16)
         {
-            // Search the section
-            if (line.substr(0, searched.size()) == searched)
+            __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first));
+            unsigned terminator = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, terminators));
+            // Bits of the characters before the terminator
+            unsigned in_line = terminator ? (terminator & -terminator) - 1 : 0xFFFF;
+
+            if (delim == nullptr)
+            {
+                unsigned found = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, delimiters)) & in_line;
+                if (found != 0)
+                {
+                    delim = first + __builtin_ctz(found);
+                    in_line &= ~((found & -found) * 2 - 1);
+                }
+            }
+            if (delim != nullptr && comment == nullptr)
+            {
+                unsigned found = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, comments)) & in_line;
+                if (found != 0)
+                {
+                    comment = first + __builtin_ctz(found);
+                }
+            }
+
+            if (terminator != 0)
             {
-                section_found = true;
+                return first + __builtin_ctz(terminator);
+            }
+            if (comment != nullptr)
+            {
+                // Only the terminator is left to find
+                return find_char(first + 16, last, '\n');
             }
         }
-        else // If the given section exists
+#endif
+        for (; first != last ; ++first)
         {
-            if (line[0] == '[')
+            if (*first == '\n')
             {
-                // We reached another section
-                file.close();
-                return default_value;
+                return first;
             }
-            else if (line[0] != dialect.commentchar && line[0] != '\0') // We check whether the key is the good one
+            if (delim == nullptr)
             {
-                int i = -1;
-                while (line[++i] != '\0'
-                       && line[i] != dialect.lineterminator
-                       && line[i] != dialect.delimiter);
-                if (line[i] == dialect.delimiter)
+                if (*first == Delimiter)
                 {
-                    if (key == stripped(line.substr(0, i)))
-                    {
-                        // The key has been found
-                        int j = i;
-                        while (line[++j] != '\0'
-                               && line[j] != dialect.lineterminator
-                               && line[j] != dialect.commentchar);
-                        file.close();
-                        return stripped(line.substr(i+1));
-                    }
+                    delim = first;
                 }
-                // Else, there is no key, strange...
+            }
+            else if (comment == nullptr && *first == CommentChar)
+            {
+                comment = first;
             }
         }
+        return nullptr;
     }
-    // Finish, an error occurred
-    file.close();
-    return default_value;
-}
-
 
-/**
-* Deletes the given section of an INI file
-*/
-auto section_delete(const char* fname, const char* section, Dialect dialect)
-    -> void
-{
-    // Open the file
-    FILE* f = fopen(fname, "r");
-    if (f == nullptr)
+    // Common dialect, whose lines are read in a
+    // single pass with the same rules as parse_line
+    template<char Delimiter, char CommentChar>
+    class FixedDialect
     {
-        throw Error(std::string(__FUNCTION__) + ": " + std::string(fname) + ": can not open file");
-    }
+        public:
+
+            auto dialect() const
+                -> Dialect
+            {
+                Dialect res;
+                res.delimiter = Delimiter;
+                res.commentchar = CommentChar;
+                return res;
+            }
+
+            auto next_line(const char* first, const char* last, LineInfo& line) const
+                -> const char*
+            {
+                line = { LineKind::EMPTY, nullptr, nullptr, nullptr, nullptr };
+                while (first != last && *first != '\n' && is_space(*first))
+                {
+                    ++first;
+                }
+                if (first == last || *first == '\n')
+                {
+                    return (first == last) ? nullptr : first;
+                }
 
-    // Creation of a temporary file
-    char temp_name[L_tmpnam];
-    tmpnam(temp_name);
-    FILE* temp = fopen(temp_name, "w");
+                if (*first == CommentChar)
+                {
+                    return find_char(first, last, '\n');
+                }
+
+                if (*first == '[')
+                {
+                    const char* line_last = find_char(first, last, '\n');
+                    if (line_last != nullptr)
+                    {
+                        const char* close = find_char(first, line_last, ']');
+                        line.kind = close ? LineKind::SECTION : LineKind::BROKEN;
+                        line.name_first = close ? first + 1 : nullptr;
+                        line.name_last = close;
+                    }
+                    return line_last;
+                }
 
-    // Create the searched word : [section]
-    size_t length = strlen(section) + 2;
-    char* searched_word = new char[length+1];
-    strcpy(searched_word, "[");
-    strcat(searched_word, section);
-    strcat(searched_word, "]");
+                const char* delim;
+                const char* comment;
+                const char* line_last = split_line<Delimiter, CommentChar>(first, last, delim, comment);
+                if (line_last == nullptr || delim == nullptr)
+                {
+                    line.kind = LineKind::OTHER;
+                    return line_last;
+                }
 
-    // Read the lines
-    bool in_section = false;
-    bool section_found = false;
-    char* line = nullptr;
-    while (io::fgetl(line, f))
+                line.kind = LineKind::KEY;
+                line.name_first = first;
+                line.name_last = delim;
+                trim(line.name_first, line.name_last);
+                line.value_first = delim + 1;
+                line.value_last = comment ? comment : line_last;
+                trim(line.value_first, line.value_last);
+                return line_last;
+            }
+    };
+
+    /*
+     * Calls on_section(name) for every section header and
+     * on_key(key, value) for every key found in a section;
+     * nothing is copied.
+     */
+    template<typename Lines, typename SectionFunction, typename KeyFunction>
+    auto scan_lines(const Lines& lines, const char* first, const char* last,
+                    SectionFunction& on_section, KeyFunction& on_key)
+        -> void
     {
-        strip(line);
-        if (in_section)
+        bool in_section = false;
+        while (first != last)
         {
-            if (line[0] == '[')
+            LineInfo line;
+            const char* line_last = lines.next_line(first, last, line);
+            if (line_last == nullptr)
             {
-                in_section = false;
+                line = parse_line(first, last, lines.dialect());
+                first = last;
             }
-        }
-        else
-        {
-            if (!strncmp(line, searched_word, length))
+            else
             {
-                in_section = true;
-                section_found = true;
+                first = line_last + 1;
+            }
+
+            // Keys outside of a section are ignored
+            switch (line.kind)
+            {
+                case LineKind::SECTION:
+                    in_section = true;
+                    on_section(StringView(line.name_first, line.name_last - line.name_first));
+                    break;
+                case LineKind::BROKEN:
+                    in_section = false;
+                    break;
+                case LineKind::KEY:
+                    if (in_section)
+                    {
+                        on_key(StringView(line.name_first, line.name_last - line.name_first),
+                               StringView(line.value_first, line.value_last - line.value_first));
+                    }
+                    break;
+                default:
+                    break;
             }
         }
+    }
 
-        // Copy the current line in the new file
-        if (!in_section)
+    template<typename SectionFunction, typename KeyFunction>
+    auto scan(const char* first, const char* last, const Dialect& dialect,
+              SectionFunction on_section, KeyFunction on_key)
+        -> void
+    {
+        if (dialect.lineterminator == '\n')
         {
-            fprintf(temp, "%s", line);
+            if (dialect.delimiter == '=' && dialect.commentchar == ';')
+            {
+                return scan_lines(FixedDialect<'=', ';'>(), first, last, on_section, on_key);
+            }
+            if (dialect.delimiter == '=' && dialect.commentchar == '#')
+            {
+                return scan_lines(FixedDialect<'=', '#'>(), first, last, on_section, on_key);
+            }
+            if (dialect.delimiter == ':' && dialect.commentchar == ';')
+            {
+                return scan_lines(FixedDialect<':', ';'>(), first, last, on_section, on_key);
+            }
+            if (dialect.delimiter == ':' && dialect.commentchar == '#')
+            {
+                return scan_lines(FixedDialect<':', '#'>(), first, last, on_section, on_key);
+            }
         }
+        scan_lines(RuntimeDialect(dialect), first, last, on_section, on_key);
     }
+}
 
-    // Finish, check errors
-    fclose(f);
-    fclose(temp);
+////////////////////////////////////////////////////////////
+// StringView
+////////////////////////////////////////////////////////////
 
-    if (!section_found)
-    {
-        throw Error(std::string(__FUNCTION__) + ": " + std::string(fname) + ": section '" + std::string(section) + "' not found");
-    }
+StringView::StringView(const char* str):
+    _data(str),
+    _size(std::strlen(str))
+{}
+
+StringView::StringView(const std::string& str):
+    _data(str.data()),
+    _size(str.size())
+{}
 
-    remove(fname);
-    rename(temp_name, fname);
+StringView::operator std::string() const
+{
+    return std::string(_data, _size);
 }
 
+auto operator==(StringView lhs, StringView rhs) noexcept
+    -> bool
+{
+    return lhs.size() == rhs.size()
+        && (lhs.size() == 0 || std::memcmp(lhs.data(), rhs.data(), lhs.size()) == 0);
+}
 
-/**
-* Deletes the given key of an INI file
-*/
-auto key_delete(const char* fname, const char* section, const char* key, Dialect dialect)
-    -> void
+auto operator!=(StringView lhs, StringView rhs) noexcept
+    -> bool
 {
-    // Open the file
-    FILE* f = fopen(fname, "r");
-    if (f == nullptr)
-    {
-        throw Error(std::string(__FUNCTION__) + ": " + std::string(fname) + ": can not open file");
-    }
+    return not (lhs == rhs);
+}
 
-    // Creation of a temporary file
-    char temp_name[L_tmpnam];
-    tmpnam(temp_name);
-    FILE* temp = fopen(temp_name, "w");
+auto operator<<(std::ostream& stream, StringView view)
+    -> std::ostream&
+{
+    return stream.write(view.data(), view.size());
+}
 
-    // Create the searched word : [section]
-    size_t length = strlen(section) + 2;
-    char* searched_word = new char[length+1];
-    strcpy(searched_word, "[");
-    strcat(searched_word, section);
-    strcat(searched_word, "]");
+Document::Document() = default;
 
-    // Read the lines
-    bool in_section = false;
-    bool in_key = false;
-    bool section_found = false;
-    bool key_found = false;
-    char* line = nullptr;
-    while (io::fgetl(line, f))
+Document::Document(const std::string& fname, Dialect dialect)
+{
+    std::ifstream file(fname, std::ios::in | std::ios::binary);
+    if (not file)
     {
-        strip(line);
-        if (!key_found)
-        {
-            if (in_section)
-            {
-                if (line[0] == '[')
-                {
-                    in_section = false;
-                    if (!key_found)
-                    {
-                        throw Error(std::string(__FUNCTION__) + ": " + std::string(fname) + ": key '" + std::string(key) + "' not found");
-                    }
-                }
-                else if (line[0] != dialect.commentchar && line[0] != '\0') // We check whether the key is the good one
-                {
-                    int i = -1;
-                    while (line[++i] != '\0'
-                           && line[i] != dialect.lineterminator
-                           && line[i] != dialect.delimiter);
-                    if (line[i] == dialect.delimiter)
-                    {
-                        if (!strcmp(key, stripped(substr(line, 0, i-1))))
-                        {
-                            // The key has been found
-                            key_found = true;
-                            in_key = true;
-                        }
-                    }
-                    // Else, there is no key, strange...
-                }
-            }
-            else
-            {
-                if (!strncmp(line, searched_word, length))
-                {
-                    in_section = true;
-                    section_found = true;
-                }
-            }
-        }
-
-        // Copy the current line in the new file
-        if (!in_key)
-        {
-            fprintf(temp, "%s", line);
-        }
-        else
-        {
-            in_key = false;
-        }
+        throw Error(std::string(__FUNCTION__) + ": " + fname + ": can not open file");
     }
 
-    fclose(f);
-    fclose(temp);
-
-    if (!section_found)
+    // Read the whole file at once
+    std::string contents;
+    file.seekg(0, std::ios::end);
+    auto size = file.tellg();
+    if (size > 0)
     {
-        throw Error(std::string(__FUNCTION__) + ": " + std::string(fname) + ": section '" + std::string(section) + "' not found");
+        contents.resize(static_cast<std::size_t>(size));
+        file.seekg(0, std::ios::beg);
+        file.read(&contents[0], size);
+        contents.resize(static_cast<std::size_t>(file.gcount()));
     }
-
-    remove(fname);
-    rename(temp_name, fname);
+    parse(contents.data(), contents.data() + contents.size(), dialect);
 }
 
-
-/**
-* Write a string in an INI file
-*/
-auto write(const char* fname, const char* section, const char* key, const char* value, Dialect dialect)
-    -> void
+auto Document::merge(const std::vector<Document>& layers)
+    -> Document
 {
-    // Open the file
-    FILE* f = fopen(fname, "r");
-    if (f == nullptr)
+    // Entries of every section, and position in
+    // them of every key, in order of appearance
+    struct Section
     {
-        // Create a new file
-        f = fopen(fname, "w");
-        fprintf(f, "[%s]\n", section);
-        fprintf(f, "%s%c%s\n", key, dialect.delimiter, value);
-    }
-
-    // Creation of a temporary file
-    char temp_name[L_tmpnam];
-    tmpnam(temp_name);
-    FILE* temp = fopen(temp_name, "w");
-
-    // Create the searched word : [section]
-    size_t length = strlen(section) + 2;
-    char* searched_word = new char[length+1];
-    strcpy(searched_word, "[");
-    strcat(searched_word, section);
-    strcat(searched_word, "]");
-
-    bool section_found = false;
-    bool key_found = false;
-    bool in_section = false;
-    bool write_line = true;
-    size_t empty_lines = 0;
-
-    char* line = nullptr;
-    while (io::fgetl(line, f))
+        std::string name;
+        std::vector<Entry> entries;
+        std::unordered_map<std::string, std::size_t> keys;
+    };
+    std::vector<Section> sections;
+    std::unordered_map<std::string, std::size_t> section_ids;
+
+    for (const Document& layer: layers)
     {
-        strip(line);
-        if (!key_found)
+        for (const auto& name: layer._sections)
         {
-            if (section_found == false)
+            auto id = section_ids.emplace(name, sections.size());
+            if (id.second)
             {
-                // Search the section
-                if (!strncmp(line, searched_word, length))
-                {
-                    in_section = true;
-                    section_found = true;
-                }
+                sections.push_back({ name, {}, {} });
             }
-            else // If the given section exists
+            Section& section = sections[id.first->second];
+
+            const SectionIndex& index = layer._index.at(name);
+            for (std::size_t i = index.first ; i < index.last ; ++i)
             {
-                if (line[0] == dialect.lineterminator)
-                {
-                    // We "store" the empty line
-                    ++empty_lines;
-                    write_line = false;
-                }
-                else if (line[0] == '[')
+                const Entry& entry = layer._entries[i];
+                auto key = section.keys.emplace(entry.key, section.entries.size());
+                if (key.second)
                 {
-                    if (in_section)
-                    {
-                        // We reached the end of the section
-                        // The key still has not be found
-                        // So we add it
-                        fprintf(temp, "%s%c%s\n", key, dialect.delimiter, value);
-                        key_found = true;
-                    }
-                    for (size_t i = 0 ; i < empty_lines ; ++i)
-                    {
-                        fprintf(temp, "%c", dialect.lineterminator);
-                    }
-                    empty_lines = 0;
+                    section.entries.push_back(entry);
                 }
                 else
                 {
-                    // Add the empty lines needed
-                    for (size_t i = 0 ; i < empty_lines ; ++i)
-                    {
-                        fprintf(temp, "%c", dialect.lineterminator);
-                    }
-                    empty_lines = 0;
-
-                    // We check whether the key is the good one
-                    if (line[0] != dialect.commentchar && line[0] != '\0')
-                    {
-                        strnorm(line, dialect);
-                        int i = -1;
-                        while (line[++i] != '\0'
-                               && line[i] != dialect.lineterminator
-                               && line[i] != dialect.delimiter);
-                        if (line[i] == dialect.delimiter)
-                        {
-                            if (!strcmp(key, stripped(substr(line, 0, i-1))))
-                            {
-                                // The key has been found
-                                fprintf(temp, "%s%c%s\n", key, dialect.delimiter, value);
-                                key_found = true;
-                                write_line = false;
-                            }
-                        }
-                    }
+                    section.entries[key.first->second].value = entry.value;
                 }
             }
         }
+    }
 
-        // Copy the current line in the new file
-        if (write_line)
+    Document res;
+    for (auto& section: sections)
+    {
+        SectionIndex index;
+        index.first = res._entries.size();
+        index.last = index.first + section.entries.size();
+        for (auto& key: section.keys)
         {
-            fprintf(temp, "%s", line);
+            key.second += index.first;
         }
-        else
+        index.keys = std::move(section.keys);
+
+        std::move(section.entries.begin(), section.entries.end(),
+                  std::back_inserter(res._entries));
+        res._index.emplace(section.name, std::move(index));
+        res._sections.push_back(std::move(section.name));
+    }
+    res._cache.resize(res._entries.size());
+    return res;
+}
+
+auto Document::parse(const char* first, const char* last, Dialect dialect)
+    -> void
+{
+    // Keys of every section, in order of appearance
+    std::vector<std::vector<Entry>> sections;
+    std::vector<Entry>* current = nullptr;
+
+    scan(first, last, dialect,
+        [&](StringView section)
+        {
+            std::string name(section);
+            auto it = _index.find(name);
+            if (it == _index.end())
+            {
+                it = _index.emplace(name, SectionIndex{}).first;
+                it->second.first = sections.size();
+                _sections.push_back(name);
+                sections.emplace_back();
+            }
+            current = &sections[it->second.first];
+        },
+        [&](StringView key, StringView value)
         {
-            write_line = true;
+            current->push_back({ std::string(), std::string(key), std::string(value) });
         }
+    );
+
+    // Flatten the sections and index their keys
+    for (std::size_t i = 0 ; i < sections.size() ; ++i)
+    {
+        auto& index = _index[_sections[i]];
+        index.first = _entries.size();
+        for (auto& entry: sections[i])
+        {
+            if (index.keys.emplace(entry.key, _entries.size()).second)
+            {
+                entry.section = _sections[i];
+                _entries.push_back(std::move(entry));
+            }
+        }
+        index.last = _entries.size();
     }
+    _cache.resize(_entries.size());
+}
+
+auto Document::section_exists(const std::string& section) const
+    -> bool
+{
+    return _index.find(section) != _index.end();
+}
+
+auto Document::key_exists(const std::string& section, const std::string& key) const
+    -> bool
+{
+    return find(section, key) != nullptr;
+}
+
+auto Document::find(const std::string& section, const std::string& key) const
+    -> const std::string*
+{
+    std::size_t index = find_index(section, key);
+    return (index == _entries.size()) ? nullptr : &_entries[index].value;
+}
 
-    if (!section_found)
+auto Document::find_index(const std::string& section, const std::string& key) const
+    -> std::size_t
+{
+    auto sec = _index.find(section);
+    if (sec == _index.end())
     {
-        fprintf(temp, "\n");
-        fprintf(temp, "%s\n", searched_word);
-        fprintf(temp, "%s%c%s\n", key, dialect.delimiter, value);
+        return _entries.size();
     }
-    else if (!key_found)
+    auto it = sec->second.keys.find(key);
+    if (it == sec->second.keys.end())
     {
-        fprintf(temp, "%s%c%s\n", key, dialect.delimiter, value);
+        return _entries.size();
     }
+    return it->second;
+}
 
-    // Finish
-    fclose(f);
-    fclose(temp);
-    remove(fname);
-    rename(temp_name, fname);
+auto Document::read(const std::string& section, const std::string& key,
+                    const std::string& default_value) const
+    -> Element
+{
+    const std::string* value = find(section, key);
+    return value ? *value : default_value;
 }
 
+namespace
+{
+    // Type tags of the cache slots, 0 is an empty slot
+    template<typename T>
+    struct CacheTag;
+
+    const unsigned char busy_tag = 0xFF;
+
+    template<> struct CacheTag<int>                 { enum: unsigned char { value = 1 }; };
+    template<> struct CacheTag<long>                { enum: unsigned char { value = 2 }; };
+    template<> struct CacheTag<long long>           { enum: unsigned char { value = 3 }; };
+    template<> struct CacheTag<unsigned>            { enum: unsigned char { value = 4 }; };
+    template<> struct CacheTag<unsigned long>       { enum: unsigned char { value = 5 }; };
+    template<> struct CacheTag<unsigned long long>  { enum: unsigned char { value = 6 }; };
+    template<> struct CacheTag<float>               { enum: unsigned char { value = 7 }; };
+    template<> struct CacheTag<double>              { enum: unsigned char { value = 8 }; };
+    template<> struct CacheTag<long double>         { enum: unsigned char { value = 9 }; };
+}
 
-/**
-* Write a real in an INI file
-*/
-auto write(const char* fname, const char* section, const char* key, double value, Dialect dialect)
-    -> void
+template<typename T>
+auto Document::cached(std::size_t index) const
+    -> T
 {
-    // Open the file
-    FILE* f = fopen(fname, "r");
-    if (f == nullptr)
+    static_assert(sizeof(T) <= sizeof(CacheSlot::value), "type too big for the cache");
+
+    const CacheSlot& slot = _cache[index];
+    unsigned char tag = slot.tag.load(std::memory_order_acquire);
+    T res;
+    if (tag == CacheTag<T>::value)
+    {
+        std::memcpy(&res, slot.value, sizeof res);
+        return res;
+    }
+
+    res = convert<T>(_entries[index].value);
+    if (tag == 0 && slot.tag.compare_exchange_strong(tag, busy_tag, std::memory_order_acquire))
     {
-        // Create a new file
-        f = fopen(fname, "w");
-        fprintf(f, "[%s]\n", section);
-        fprintf(f, "%s%c%f\n", key, dialect.delimiter, value);
+        std::memcpy(slot.value, &res, sizeof res);
+        slot.tag.store(CacheTag<T>::value, std::memory_order_release);
     }
+    return res;
+}
 
-    // Creation of a temporary file
-    char temp_name[L_tmpnam];
-    tmpnam(temp_name);
-    FILE* temp = fopen(temp_name, "w");
+template<>
+auto Document::cached<std::string>(std::size_t index) const
+    -> std::string
+{
+    return _entries[index].value;
+}
 
-    // Create the searched word : [section]
-    size_t length = strlen(section) + 2;
-    char* searched_word = new char[length+1];
-    strcpy(searched_word, "[");
-    strcat(searched_word, section);
-    strcat(searched_word, "]");
+template<typename T>
+auto Document::get(const std::string& section, const std::string& key,
+                   const T& default_value) const
+    -> T
+{
+    std::size_t index = find_index(section, key);
+    return (index == _entries.size()) ? default_value : cached<T>(index);
+}
 
-    bool section_found = false;
-    bool key_found = false;
-    bool in_section = false;
-    bool write_line = true;
-    size_t empty_lines = 0;
+#define X(type, func) \
+    template auto Document::get<type>(const std::string&, const std::string&, \
+                                      const type&) const -> type;
+#include <POLDER/details/ini.def>
+X(std::string, _)
+#undef X
 
-    char* line = nullptr;
-    while (io::fgetl(line, f))
+auto Document::sections() const
+    -> const std::vector<std::string>&
+{
+    return _sections;
+}
+
+auto Document::section(const std::string& section) const
+    -> std::pair<const_iterator, const_iterator>
+{
+    auto it = _index.find(section);
+    if (it == _index.end())
     {
-        strip(line);
-        if (!key_found)
-        {
-            if (section_found == false)
-            {
-                // Search the section
-                if (!strncmp(line, searched_word, length))
-                {
-                    in_section = true;
-                    section_found = true;
-                }
-            }
-            else // If the given section exists
-            {
-                if (line[0] == dialect.lineterminator)
-                {
-                    // We "store" the empty line
-                    ++empty_lines;
-                    write_line = false;
-                }
-                else if (line[0] == '[')
-                {
-                    if (in_section)
-                    {
-                        // We reached the end of the section
-                        // The key still has not be found
-                        // So we add it
-                        fprintf(temp, "%s%c%f\n", key, dialect.delimiter, value);
-                        key_found = true;
-                    }
-                    for (size_t i = 0 ; i < empty_lines ; ++i)
-                    {
-                        fprintf(temp, "%c", dialect.lineterminator);
-                    }
-                    empty_lines = 0;
-                }
-                else
-                {
-                    // Add the empty lines needed
-                    for (size_t i = 0 ; i < empty_lines ; ++i)
-                    {
-                        fprintf(temp, "%c", dialect.lineterminator);
-                    }
-                    empty_lines = 0;
+        return { _entries.end(), _entries.end() };
+    }
+    return { _entries.begin() + it->second.first,
+             _entries.begin() + it->second.last };
+}
 
+auto Document::begin() const
+    -> const_iterator
+{
+    return _entries.begin();
+}
 
-                    // We check whether the key is the good one
-                    if (line[0] != dialect.commentchar && line[0] != '\0')
-                    {
-                        strnorm(line, dialect);
-                        int i = -1;
-                        while (line[++i] != '\0'
-                               && line[i] != dialect.lineterminator
-                               && line[i] != dialect.delimiter);
-                        if (line[i] == dialect.delimiter)
-                        {
-                            if (!strcmp(key, stripped(substr(line, 0, i-1))))
-                            {
-                                // The key has been found
-                                fprintf(temp, "%s%c%f\n", key, dialect.delimiter, value);
-                                key_found = true;
-                                write_line = false;
-                            }
-                        }
-                    }
-                }
-            }
-        }
+auto Document::end() const
+    -> const_iterator
+{
+    return _entries.end();
+}
 
-        // Copy the current line in the new file
-        if (write_line)
-        {
-            fprintf(temp, "%s", line);
-        }
-        else
+auto Document::size() const
+    -> std::size_t
+{
+    return _entries.size();
+}
+
+
+////////////////////////////////////////////////////////////
+// MappedDocument
+////////////////////////////////////////////////////////////
+
+namespace
+{
+    constexpr std::uint64_t fnv_offset = 14695981039346656037ull;
+    constexpr std::uint64_t fnv_prime = 1099511628211ull;
+
+    // FNV-1a hash, continued from a previous hash
+    auto hash(StringView view, std::uint64_t res=fnv_offset)
+        -> std::uint64_t
+    {
+        for (char c: view)
         {
-            write_line = true;
+            res ^= static_cast<unsigned char>(c);
+            res *= fnv_prime;
         }
+        return res;
     }
 
-    if (!section_found)
+    auto hash(StringView section, StringView key)
+        -> std::uint64_t
     {
-        fprintf(temp, "\n");
-        fprintf(temp, "%s\n", searched_word);
-        fprintf(temp, "%s%c%f\n", key, dialect.delimiter, value);
+        // The separator avoids collisions between
+        // [ab] c and [a] bc
+        return hash(key, (hash(section) ^ 0xff) * fnv_prime);
     }
-    else if (!key_found)
+
+    // Smallest power of 2 with a load factor below 1/2
+    auto table_size(std::size_t nb_elements)
+        -> std::size_t
     {
-        fprintf(temp, "%s%c%f\n", key, dialect.delimiter, value);
+        std::size_t res = 8;
+        while (res < 2 * nb_elements)
+        {
+            res *= 2;
+        }
+        return res;
     }
 
-    // Finish
-    fclose(f);
-    fclose(temp);
-    remove(fname);
-    rename(temp_name, fname);
-}
-
-/**
-* Renames the given section of an INI file
-*/
-auto section_rename(const char* fname, const char* section, const char* new_section, Dialect dialect)
-    -> void
-{
-    // Open the file
-    FILE* f = fopen(fname, "r");
-    if (f == nullptr)
+    // Slot of the element matching the predicate, or
+    // the empty slot where it would be inserted
+    template<typename Predicate>
+    auto probe(const std::uint32_t* table, std::size_t size,
+               std::uint64_t hash_value, Predicate matches)
+        -> std::size_t
     {
-        throw Error(std::string(__FUNCTION__) + ": " + std::string(fname) + ": can not open file");
+        std::size_t mask = size - 1;
+        std::size_t slot = hash_value & mask;
+        while (table[slot] != 0 && not matches(table[slot] - 1))
+        {
+            slot = (slot + 1) & mask;
+        }
+        return slot;
     }
 
-    // Creation of a temporary file
-    char temp_name[L_tmpnam];
-    tmpnam(temp_name);
-    FILE* temp = fopen(temp_name, "w");
-
-    // Create the searched word : [section]
-    size_t length = strlen(section) + 2;
-    char* searched_word = new char[length+1];
-    strcpy(searched_word, "[");
-    strcat(searched_word, section);
-    strcat(searched_word, "]");
-
-    // Create the searched word : [new_section]
-    size_t new_length = strlen(new_section) + 2;
-    char* new_searched_word = new char[new_length+1];
-    strcpy(new_searched_word, "[");
-    strcat(new_searched_word, new_section);
-    strcat(new_searched_word, "]");
+    template<typename Predicate>
+    auto probe(const std::vector<std::uint32_t>& table, std::uint64_t hash_value, Predicate matches)
+        -> std::size_t
+    {
+        return probe(table.data(), table.size(), hash_value, matches);
+    }
 
-    bool section_found = false;
-    bool write_line = true;
-    char* line = nullptr;
-    while (io::fgetl(line, f))
+    // Adds the last name to a table of the indices + 1
+    // of the names, which grows when it is half full
+    auto add_name(std::vector<std::uint32_t>& table, const std::vector<StringView>& names)
+        -> void
     {
-        lstrip(line);
-        if (!strncmp(line, searched_word, length))
+        if (table.size() < 2 * names.size())
         {
-            fprintf(temp, "%s%c", new_searched_word, dialect.lineterminator);
-            write_line = false;
-            section_found = true;
+            table.assign(table_size(names.size()), 0);
+            for (std::size_t i = 0 ; i < names.size() ; ++i)
+            {
+                auto slot = probe(table, hash(names[i]),
+                                  [](std::size_t) { return false; });
+                table[slot] = i + 1;
+            }
         }
-        else if (!strncmp(line, new_searched_word, new_length))
+        else
         {
-            fclose(f);
-            fclose(temp);
-            throw Error(std::string(__FUNCTION__) + ": " + std::string(fname) + ": section '" + std::string(new_section) + "' already exists");
+            auto slot = probe(table, hash(names.back()),
+                              [](std::size_t) { return false; });
+            table[slot] = names.size();
         }
+    }
 
-        // Copy the current line in the new file
-        if (write_line)
-        {
-            fprintf(temp, "%s", line);
-        }
-        else
+    // Maps a file in memory, or reads it into the
+    // buffer when it can not be mapped
+    auto map_file(const char* func, const std::string& fname,
+                  const char*& data, std::size_t& size, std::vector<char>& buffer)
+        -> void
+    {
+        #ifndef POLDER_OS_WINDOWS
+            int fd = ::open(fname.c_str(), O_RDONLY);
+            if (fd == -1)
+            {
+                throw Error(std::string(func) + ": " + fname + ": can not open file");
+            }
+            struct stat info;
+            if (::fstat(fd, &info) == 0 && info.st_size > 0)
+            {
+                void* addr = ::mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (addr != MAP_FAILED)
+                {
+                    data = static_cast<const char*>(addr);
+                    size = info.st_size;
+                }
+            }
+            ::close(fd);
+        #endif
+
+        if (data == nullptr)
         {
-            write_line = true;
+            std::ifstream file(fname, std::ios::in | std::ios::binary);
+            if (not file)
+            {
+                throw Error(std::string(func) + ": " + fname + ": can not open file");
+            }
+            buffer.assign(std::istreambuf_iterator<char>(file),
+                          std::istreambuf_iterator<char>());
+            data = buffer.data();
+            size = buffer.size();
         }
     }
 
-    // Finish, check errors
-    fclose(f);
-    fclose(temp);
-    remove(fname);
-    rename(temp_name, fname);
-
-    if (!section_found)
+    auto unmap_file(const char* data, std::size_t size, const std::vector<char>& buffer)
+        -> void
     {
-        throw Error(std::string(__FUNCTION__) + ": " + std::string(fname) + ": section '" + std::string(section) + "' not found");
+        #ifndef POLDER_OS_WINDOWS
+            if (data != nullptr && buffer.empty())
+            {
+                ::munmap(const_cast<char*>(data), size);
+            }
+        #endif
     }
 }
 
-/**
-* Renames the given key of an INI file
-*/
-auto key_rename(const char* fname, const char* section, const char* key, const char* new_key, Dialect dialect)
-    -> void
+MappedDocument::MappedDocument(const std::string& fname, Dialect dialect):
+    _data(nullptr),
+    _size(0)
 {
-    // Open the file
-    FILE* f = fopen(fname, "r");
-    if (f == nullptr)
-    {
-        throw Error(std::string(__FUNCTION__) + ": " + std::string(fname) + ": can not open file");
-    }
+    map_file(__FUNCTION__, fname, _data, _size, _buffer);
+    parse(dialect);
+}
+
+MappedDocument::MappedDocument(MappedDocument&& other) noexcept:
+    _data(other._data),
+    _size(other._size),
+    _buffer(std::move(other._buffer)),
+    _entries(std::move(other._entries)),
+    _sections(std::move(other._sections)),
+    _ranges(std::move(other._ranges)),
+    _section_table(std::move(other._section_table)),
+    _key_table(std::move(other._key_table))
+{
+    other._data = nullptr;
+    other._size = 0;
+}
 
-    // Creation of a temporary file
-    char temp_name[L_tmpnam];
-    tmpnam(temp_name);
-    FILE* temp = fopen(temp_name, "w");
+MappedDocument::~MappedDocument()
+{
+    unmap_file(_data, _size, _buffer);
+}
 
-    // Create the searched word : [section]
-    size_t length = strlen(section) + 2;
-    char* searched_word = new char[length+1];
-    strcpy(searched_word, "[");
-    strcat(searched_word, section);
-    strcat(searched_word, "]");
+auto MappedDocument::operator=(MappedDocument&& other) noexcept
+    -> MappedDocument&
+{
+    // The old mapping is released with tmp
+    MappedDocument tmp(std::move(other));
+    std::swap(_data, tmp._data);
+    std::swap(_size, tmp._size);
+    _buffer.swap(tmp._buffer);
+    _entries.swap(tmp._entries);
+    _sections.swap(tmp._sections);
+    _ranges.swap(tmp._ranges);
+    _section_table.swap(tmp._section_table);
+    _key_table.swap(tmp._key_table);
+    return *this;
+}
 
-    bool section_found = false;
-    bool key_found = false;
-    bool in_section = false;
-    bool write_line = true;
-    char* line = nullptr;
-    while (io::fgetl(line, f))
-    {
-        if (!key_found)
+auto MappedDocument::parse(Dialect dialect)
+    -> void
+{
+    // Section of every entry
+    std::vector<std::uint32_t> owners;
+    bool grouped = true;
+    std::size_t current = 0;
+    _section_table.assign(table_size(0), 0);
+
+    scan(_data, _data + _size, dialect,
+        [&](StringView section)
         {
-            strip(line);
-            if (!section_found)
+            current = find_section(section);
+            if (current != _sections.size())
             {
-                if (!strncmp(line, searched_word, length))
-                {
-                    section_found = true;
-                    in_section = true;
-                }
+                return;
             }
-            else if (in_section)
+
+            _sections.push_back(section);
+            add_name(_section_table, _sections);
+        },
+        [&](StringView key, StringView value)
+        {
+            if (not owners.empty() && current < owners.back())
             {
-                if (line[0] == '[')
-                {
-                    throw Error(std::string(__FUNCTION__) + ": " + std::string(fname) + ": key '" + std::string(key) + "' not found");
-                }
-                // We check whether the key is the good one
-                else if (line[0] != dialect.commentchar && line[0] != '\0')
-                {
-                    strnorm(line, dialect);
-                    int i = -1;
-                    while (line[++i] != '\0'
-                           && line[i] != dialect.lineterminator
-                           && line[i] != dialect.delimiter);
-                    if (line[i] == dialect.delimiter)
-                    {
-                        if (!strcmp(key, stripped(substr(line, 0, i-1))))
-                        {
-                            // The key has been found
-                            key_found = true;
-                            write_line = false;
-                            int j = i;
-                            while (line[++j] != '\0'
-                                   && line[j] != dialect.lineterminator
-                                   && line[j] != dialect.commentchar);
-                            fprintf(temp, "%s%c%s\n", new_key, dialect.delimiter, substr(line, i+1, j-1));
-                        }
-                        else if (!strcmp(new_key, stripped(substr(line, 0, i-1))))
-                        {
-                            throw Error(std::string(__FUNCTION__) + ": " + std::string(fname) + ": key '" + std::string(new_key) + "' already exists");
-                        }
-                    }
-                }
+                grouped = false;
             }
+            owners.push_back(current);
+            _entries.push_back({ _sections[current], key, value });
         }
+    );
 
-        // Copy the current line in the new file
-        if (write_line)
+    if (not grouped)
+    {
+        // A section appears several times: stable
+        // counting sort of the entries by section
+        std::vector<std::size_t> positions(_sections.size() + 1, 0);
+        for (auto owner: owners)
         {
-            fprintf(temp, "%s", line);
+            ++positions[owner + 1];
         }
-        else
+        for (std::size_t i = 1 ; i < positions.size() ; ++i)
+        {
+            positions[i] += positions[i-1];
+        }
+        std::vector<Entry> entries(_entries.size());
+        std::vector<std::uint32_t> sorted_owners(owners.size());
+        for (std::size_t i = 0 ; i < _entries.size() ; ++i)
         {
-            write_line = true;
+            auto pos = positions[owners[i]]++;
+            entries[pos] = _entries[i];
+            sorted_owners[pos] = owners[i];
         }
+        _entries.swap(entries);
+        owners.swap(sorted_owners);
     }
 
-    // Finish, check errors
-    fclose(f);
-    fclose(temp);
-
-    if (!section_found)
+    // Index the keys, only keeping the
+    // first value of every key
+    _key_table.assign(table_size(_entries.size()), 0);
+    _ranges.assign(_sections.size(), { 0, 0 });
+    std::size_t nb_entries = 0;
+    for (std::size_t i = 0 ; i < _entries.size() ; ++i)
     {
-        throw Error(std::string(__FUNCTION__) + ": " + std::string(fname) + ": section '" + std::string(section) + "' not found");
+        const Entry& entry = _entries[i];
+        auto slot = probe(_key_table, hash(entry.section, entry.key),
+                          [&](std::size_t index)
+                          {
+                              return _entries[index].section == entry.section
+                                  && _entries[index].key == entry.key;
+                          });
+        if (_key_table[slot] != 0)
+        {
+            continue;
+        }
+        _key_table[slot] = nb_entries + 1;
+
+        auto& range = _ranges[owners[i]];
+        if (range.first == range.second)
+        {
+            range.first = nb_entries;
+        }
+        _entries[nb_entries++] = entry;
+        range.second = nb_entries;
     }
+    _entries.resize(nb_entries);
+}
+
+auto MappedDocument::find_section(StringView section) const
+    -> std::size_t
+{
+    auto slot = probe(_section_table, hash(section),
+                      [&](std::size_t index) { return _sections[index] == section; });
+    return (_section_table[slot] == 0) ? _sections.size() : _section_table[slot] - 1;
+}
+
+auto MappedDocument::section_exists(StringView section) const
+    -> bool
+{
+    return find_section(section) != _sections.size();
+}
+
+auto MappedDocument::key_exists(StringView section, StringView key) const
+    -> bool
+{
+    return find(section, key) != nullptr;
+}
 
-    remove(fname);
-    rename(temp_name, fname);
+auto MappedDocument::find(StringView section, StringView key) const
+    -> const StringView*
+{
+    auto slot = probe(_key_table, hash(section, key),
+                      [&](std::size_t index)
+                      {
+                          return _entries[index].section == section
+                              && _entries[index].key == key;
+                      });
+    if (_key_table[slot] == 0)
+    {
+        return nullptr;
+    }
+    return &_entries[_key_table[slot] - 1].value;
+}
+
+auto MappedDocument::read(StringView section, StringView key, StringView default_value) const
+    -> StringView
+{
+    const StringView* value = find(section, key);
+    return value ? *value : default_value;
+}
+
+template<typename T>
+auto MappedDocument::get(StringView section, StringView key, const T& default_value) const
+    -> T
+{
+    const StringView* value = find(section, key);
+    return value ? convert<T>(value->data(), value->data() + value->size()) : default_value;
+}
+
+#define X(type, func) \
+    template auto MappedDocument::get<type>(StringView, StringView, \
+                                            const type&) const -> type;
+#include <POLDER/details/ini.def>
+X(std::string, _)
+#undef X
+
+auto MappedDocument::sections() const
+    -> const std::vector<StringView>&
+{
+    return _sections;
+}
+
+auto MappedDocument::section(StringView section) const
+    -> std::pair<const_iterator, const_iterator>
+{
+    auto index = find_section(section);
+    if (index == _sections.size())
+    {
+        return { _entries.end(), _entries.end() };
+    }
+    return { _entries.begin() + _ranges[index].first,
+             _entries.begin() + _ranges[index].second };
+}
+
+auto MappedDocument::begin() const
+    -> const_iterator
+{
+    return _entries.begin();
+}
+
+auto MappedDocument::end() const
+    -> const_iterator
+{
+    return _entries.end();
+}
+
+auto MappedDocument::size() const
+    -> std::size_t
+{
+    return _entries.size();
+}
+
+
+////////////////////////////////////////////////////////////
+// LazyDocument
+////////////////////////////////////////////////////////////
+
+struct LazyDocument::Section
+{
+    // Every occurrence of the section, from its
+    // header to the next header or to the end
+    std::vector<std::pair<const char*, const char*>> ranges;
+
+    std::once_flag parsed;
+    std::vector<Entry> entries;
+    std::vector<std::uint32_t> table;   // Indices + 1 of the entries
+};
+
+LazyDocument::LazyDocument(const std::string& fname, Dialect dialect):
+    _data(nullptr),
+    _size(0),
+    _dialect(dialect)
+{
+    map_file(__FUNCTION__, fname, _data, _size, _buffer);
+    index();
+}
+
+LazyDocument::LazyDocument(LazyDocument&& other) noexcept:
+    _data(other._data),
+    _size(other._size),
+    _buffer(std::move(other._buffer)),
+    _dialect(other._dialect),
+    _names(std::move(other._names)),
+    _sections(std::move(other._sections)),
+    _section_table(std::move(other._section_table))
+{
+    other._data = nullptr;
+    other._size = 0;
+}
+
+LazyDocument::~LazyDocument()
+{
+    unmap_file(_data, _size, _buffer);
+}
+
+auto LazyDocument::operator=(LazyDocument&& other) noexcept
+    -> LazyDocument&
+{
+    // The old mapping is released with tmp
+    LazyDocument tmp(std::move(other));
+    std::swap(_data, tmp._data);
+    std::swap(_size, tmp._size);
+    _buffer.swap(tmp._buffer);
+    std::swap(_dialect, tmp._dialect);
+    _names.swap(tmp._names);
+    _sections.swap(tmp._sections);
+    _section_table.swap(tmp._section_table);
+    return *this;
+}
+
+auto LazyDocument::index()
+    -> void
+{
+    _section_table.assign(table_size(0), 0);
+    if (_size == 0)
+    {
+        // An empty file is not mapped
+        return;
+    }
+
+    const char* first = _data;
+    const char* last = _data + _size;
+    Section* current = nullptr;
+
+    // Only the brackets at the beginning of a line
+    // matter, the other lines are not even split
+    const char* pos = first;
+    while ((pos = find_char(pos, last, '[')) != nullptr)
+    {
+        const char* line_first = pos;
+        while (line_first != first
+               && line_first[-1] != _dialect.lineterminator
+               && is_space(line_first[-1]))
+        {
+            --line_first;
+        }
+        const char* line_last = find_char(pos, last, _dialect.lineterminator);
+        if (line_last == nullptr)
+        {
+            line_last = last;
+        }
+        pos = line_last;
+        if (line_first != first && line_first[-1] != _dialect.lineterminator)
+        {
+            continue;
+        }
+
+        // Any header ends the current section,
+        // even one without a closing bracket
+        if (current != nullptr)
+        {
+            current->ranges.back().second = line_first;
+            current = nullptr;
+        }
+        LineInfo line = parse_line(line_first, line_last, _dialect);
+        if (line.kind != LineKind::SECTION)
+        {
+            continue;
+        }
+
+        StringView name(line.name_first, line.name_last - line.name_first);
+        auto id = find_section(name);
+        if (id == _names.size())
+        {
+            _names.push_back(name);
+            _sections.emplace_back(new Section);
+            add_name(_section_table, _names);
+        }
+        current = _sections[id].get();
+        current->ranges.emplace_back(line_first, last);
+    }
+}
+
+auto LazyDocument::find_section(StringView section) const
+    -> std::size_t
+{
+    auto slot = probe(_section_table, hash(section),
+                      [&](std::size_t index) { return _names[index] == section; });
+    return (_section_table[slot] == 0) ? _names.size() : _section_table[slot] - 1;
+}
+
+auto LazyDocument::load(std::size_t index) const
+    -> const Section&
+{
+    Section& sec = *_sections[index];
+    std::call_once(sec.parsed, [&]
+    {
+        for (const auto& range: sec.ranges)
+        {
+            scan(range.first, range.second, _dialect,
+                [](StringView) {},
+                [&](StringView key, StringView value)
+                {
+                    sec.entries.push_back({ _names[index], key, value });
+                }
+            );
+        }
+
+        // Only keep the first value of every key
+        sec.table.assign(table_size(sec.entries.size()), 0);
+        std::size_t nb_entries = 0;
+        for (const Entry& entry: sec.entries)
+        {
+            auto slot = probe(sec.table, hash(entry.key),
+                              [&](std::size_t i) { return sec.entries[i].key == entry.key; });
+            if (sec.table[slot] == 0)
+            {
+                sec.entries[nb_entries++] = entry;
+                sec.table[slot] = nb_entries;
+            }
+        }
+        sec.entries.resize(nb_entries);
+    });
+    return sec;
+}
+
+auto LazyDocument::section_exists(StringView section) const
+    -> bool
+{
+    return find_section(section) != _names.size();
+}
+
+auto LazyDocument::key_exists(StringView section, StringView key) const
+    -> bool
+{
+    return find(section, key) != nullptr;
+}
+
+auto LazyDocument::find(StringView section, StringView key) const
+    -> const StringView*
+{
+    auto index = find_section(section);
+    if (index == _names.size())
+    {
+        return nullptr;
+    }
+    const Section& sec = load(index);
+    auto slot = probe(sec.table, hash(key),
+                      [&](std::size_t i) { return sec.entries[i].key == key; });
+    if (sec.table[slot] == 0)
+    {
+        return nullptr;
+    }
+    return &sec.entries[sec.table[slot] - 1].value;
+}
+
+auto LazyDocument::read(StringView section, StringView key, StringView default_value) const
+    -> StringView
+{
+    const StringView* value = find(section, key);
+    return value ? *value : default_value;
+}
+
+template<typename T>
+auto LazyDocument::get(StringView section, StringView key, const T& default_value) const
+    -> T
+{
+    const StringView* value = find(section, key);
+    return value ? convert<T>(value->data(), value->data() + value->size()) : default_value;
+}
+
+#define X(type, func) \
+    template auto LazyDocument::get<type>(StringView, StringView, \
+                                          const type&) const -> type;
+#include <POLDER/details/ini.def>
+X(std::string, _)
+#undef X
+
+auto LazyDocument::sections() const
+    -> const std::vector<StringView>&
+{
+    return _names;
+}
+
+auto LazyDocument::section(StringView section) const
+    -> std::pair<const_iterator, const_iterator>
+{
+    static const std::vector<Entry> no_entries;
+    auto index = find_section(section);
+    if (index == _names.size())
+    {
+        return { no_entries.end(), no_entries.end() };
+    }
+    const Section& sec = load(index);
+    return { sec.entries.begin(), sec.entries.end() };
+}
+
+
+////////////////////////////////////////////////////////////
+// StreamReader
+////////////////////////////////////////////////////////////
+
+StreamReader::StreamReader(const std::string& fname, Dialect dialect, std::size_t buffer_size):
+    _fname(fname),
+    _file(fname, std::ios::in | std::ios::binary),
+    _dialect(dialect),
+    _buffer(std::max<std::size_t>(buffer_size, 1)),
+    _first(0),
+    _last(0),
+    _eof(false),
+    _in_section(false)
+{
+    if (not _file)
+    {
+        throw Error(std::string(__FUNCTION__) + ": " + fname + ": can not open file");
+    }
+}
+
+auto StreamReader::next()
+    -> bool
+{
+    if (_dialect.lineterminator == '\n')
+    {
+        if (_dialect.delimiter == '=' && _dialect.commentchar == ';')
+        {
+            return next_key(FixedDialect<'=', ';'>());
+        }
+        if (_dialect.delimiter == '=' && _dialect.commentchar == '#')
+        {
+            return next_key(FixedDialect<'=', '#'>());
+        }
+        if (_dialect.delimiter == ':' && _dialect.commentchar == ';')
+        {
+            return next_key(FixedDialect<':', ';'>());
+        }
+        if (_dialect.delimiter == ':' && _dialect.commentchar == '#')
+        {
+            return next_key(FixedDialect<':', '#'>());
+        }
+    }
+    return next_key(RuntimeDialect(_dialect));
+}
+
+template<typename Lines>
+auto StreamReader::next_key(const Lines& lines)
+    -> bool
+{
+    while (true)
+    {
+        const char* first = _buffer.data() + _first;
+        const char* last = _buffer.data() + _last;
+        LineInfo line;
+        const char* line_last = lines.next_line(first, last, line);
+        if (line_last == nullptr)
+        {
+            if (not _eof)
+            {
+                fill();
+                continue;
+            }
+            if (first == last)
+            {
+                return false;
+            }
+            // Last line, without terminator
+            line = parse_line(first, last, _dialect);
+            _first = _last;
+        }
+        else
+        {
+            _first = line_last + 1 - _buffer.data();
+        }
+
+        switch (line.kind)
+        {
+            case LineKind::SECTION:
+                _in_section = true;
+                _section.assign(line.name_first, line.name_last);
+                break;
+            case LineKind::BROKEN:
+                _in_section = false;
+                break;
+            case LineKind::KEY:
+                // Keys outside of a section are ignored
+                if (_in_section)
+                {
+                    _key = StringView(line.name_first, line.name_last - line.name_first);
+                    _value = StringView(line.value_first, line.value_last - line.value_first);
+                    return true;
+                }
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+auto StreamReader::section() const noexcept
+    -> StringView
+{
+    return _section;
+}
+
+auto StreamReader::key() const noexcept
+    -> StringView
+{
+    return _key;
+}
+
+auto StreamReader::value() const noexcept
+    -> StringView
+{
+    return _value;
+}
+
+auto StreamReader::fill()
+    -> void
+{
+    if (_first > 0)
+    {
+        std::memmove(_buffer.data(), _buffer.data() + _first, _last - _first);
+        _last -= _first;
+        _first = 0;
+    }
+    if (_last == _buffer.size())
+    {
+        // The line does not fit in the buffer
+        _buffer.resize(2 * _buffer.size());
+    }
+
+    std::size_t size = _buffer.size() - _last;
+    _file.read(_buffer.data() + _last, size);
+    auto count = static_cast<std::size_t>(_file.gcount());
+    if (_file.bad())
+    {
+        throw Error(std::string(__FUNCTION__) + ": " + _fname + ": can not read file");
+    }
+    _last += count;
+    _eof = count < size;
+}
+
+
+////////////////////////////////////////////////////////////
+// Editor
+////////////////////////////////////////////////////////////
+
+namespace
+{
+    auto editor_error(const char* func, const std::string& fname, const std::string& msg)
+        -> Error
+    {
+        return Error(std::string(func) + ": " + fname + ": " + msg);
+    }
+
+    auto is_blank(const std::string& text)
+        -> bool
+    {
+        return std::all_of(text.begin(), text.end(), is_space);
+    }
+
+    // Directory of a file, and name of the file in it
+    auto split_path(const std::string& fname)
+        -> std::pair<std::string, std::string>
+    {
+        auto slash = fname.rfind('/');
+        if (slash == std::string::npos)
+        {
+            return { ".", fname };
+        }
+        return { (slash == 0) ? "/" : fname.substr(0, slash), fname.substr(slash+1) };
+    }
+
+#ifndef POLDER_OS_WINDOWS
+    auto write_all(int fd, const char* data, std::size_t size)
+        -> bool
+    {
+        while (size > 0)
+        {
+            ssize_t count = ::write(fd, data, size);
+            if (count < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                return false;
+            }
+            data += count;
+            size -= count;
+        }
+        return true;
+    }
+
+    // Creates a new file next to fname with a random suffix;
+    // the kernel applies the umask to its mode, as it does
+    // for the other files created by the process
+    auto create_temporary(const std::string& fname, std::string& temp_name)
+        -> int
+    {
+        static const char digits[] = "0123456789abcdefghijklmnopqrstuvwxyz";
+        std::random_device device;
+        for (int attempt = 0 ; attempt < 100 ; ++attempt)
+        {
+            temp_name = fname + '.';
+            for (int i = 0 ; i < 8 ; ++i)
+            {
+                temp_name += digits[device() % (sizeof digits - 1)];
+            }
+            int fd = ::open(temp_name.c_str(), O_CREAT | O_EXCL | O_WRONLY | O_CLOEXEC, 0666);
+            if (fd >= 0 || errno != EEXIST)
+            {
+                return fd;
+            }
+        }
+        return -1;
+    }
+
+    /*
+     * Replaces the contents of a file so that a crash leaves
+     * either the old file or the new one: the temporary file
+     * is created in the same directory so that rename stays
+     * atomic, and the directory is synced so that the rename
+     * itself survives a power loss.
+     */
+    auto replace_file(const std::string& fname, const std::string& contents)
+        -> bool
+    {
+        std::string temp_name;
+        int fd = create_temporary(fname, temp_name);
+        if (fd < 0)
+        {
+            return false;
+        }
+
+        // Keep the mode of the file that is replaced
+        struct stat info;
+        bool written = (::stat(fname.c_str(), &info) != 0 || ::fchmod(fd, info.st_mode & 07777) == 0)
+                    && write_all(fd, contents.data(), contents.size())
+                    && ::fsync(fd) == 0;
+        written = (::close(fd) == 0) && written;
+        if (not written || std::rename(temp_name.c_str(), fname.c_str()) != 0)
+        {
+            ::unlink(temp_name.c_str());
+            return false;
+        }
+
+        int dir = ::open(split_path(fname).first.c_str(), O_RDONLY | O_DIRECTORY);
+        if (dir < 0)
+        {
+            return false;
+        }
+        bool synced = ::fsync(dir) == 0;
+        return (::close(dir) == 0) && synced;
+    }
+#else
+    // Without POSIX, rename can not replace a file
+    auto replace_file(const std::string& fname, const std::string& contents)
+        -> bool
+    {
+        std::string temp_name = fname + ".tmp";
+        {
+            std::ofstream file(temp_name, std::ios::binary | std::ios::trunc);
+            if (not file.write(contents.data(), contents.size()) || not file.flush())
+            {
+                std::remove(temp_name.c_str());
+                return false;
+            }
+        }
+        std::remove(fname.c_str());
+        return std::rename(temp_name.c_str(), fname.c_str()) == 0;
+    }
+#endif
+}
+
+Editor::Editor(const std::string& fname, Dialect dialect):
+    _fname(fname),
+    _dialect(dialect),
+    _final_terminator(true),
+    _write_behind(0),
+    _pending(false),
+    _failed(false),
+    _stopped(false)
+{
+    std::ifstream file(fname, std::ios::binary);
+    if (not file)
+    {
+        // Created by commit
+        return;
+    }
+    std::string contents((std::istreambuf_iterator<char>(file)),
+                         std::istreambuf_iterator<char>());
+    if (contents.empty())
+    {
+        return;
+    }
+    _final_terminator = contents.back() == dialect.lineterminator;
+
+    const char* first = contents.data();
+    const char* last = first + contents.size() - _final_terminator;
+    std::string section;
+    bool in_section = false;
+    while (true)
+    {
+        const char* line_last = find_char(first, last, dialect.lineterminator);
+        if (line_last == nullptr)
+        {
+            line_last = last;
+        }
+
+        auto line = add_line(_lines.end(), std::string(first, line_last));
+        switch (line->kind)
+        {
+            case Kind::SECTION:
+                in_section = true;
+                section = line->text.substr(line->name_first, line->name_last - line->name_first);
+                _headers[section].push_back(line);
+                break;
+            case Kind::BROKEN:
+                in_section = false;
+                break;
+            case Kind::KEY:
+                // The first value of a key wins
+                if (in_section)
+                {
+                    auto key = line->text.substr(line->name_first, line->name_last - line->name_first);
+                    _keys[section].emplace(key, line);
+                }
+                break;
+            default:
+                break;
+        }
+
+        if (line_last == last)
+        {
+            break;
+        }
+        first = line_last + 1;
+    }
+}
+
+Editor::~Editor()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stopped = true;
+    }
+    _wake.notify_one();
+    if (_thread.joinable())
+    {
+        _thread.join();
+    }
+
+    try
+    {
+        flush();
+    }
+    catch (const Error& error)
+    {
+        if (_error_handler)
+        {
+            _error_handler(error);
+        }
+    }
+}
+
+auto Editor::set(const std::string& section, const std::string& key, const std::string& value)
+    -> void
+{
+    auto headers = _headers.find(section);
+    if (headers == _headers.end())
+    {
+        // New section at the end of the file
+        if (not _lines.empty())
+        {
+            add_line(_lines.end(), "");
+        }
+        _headers[section].push_back(add_line(_lines.end(), '[' + section + ']'));
+        _keys[section][key] = add_line(_lines.end(), key + _dialect.delimiter + value);
+        return;
+    }
+
+    auto& keys = _keys[section];
+    auto it = keys.find(key);
+    if (it != keys.end())
+    {
+        Line& line = *it->second;
+        line.text.replace(line.value_first, line.value_last - line.value_first, value);
+        line.value_last = line.value_first + value.size();
+        return;
+    }
+
+    // New key after the last non-blank line
+    // of the first occurrence of the section
+    auto pos = std::next(headers->second.front());
+    for (auto line = pos ; line != _lines.end() ; ++line)
+    {
+        if (line->kind == Kind::SECTION || line->kind == Kind::BROKEN)
+        {
+            break;
+        }
+        if (not is_blank(line->text))
+        {
+            pos = std::next(line);
+        }
+    }
+    keys[key] = add_line(pos, key + _dialect.delimiter + value);
+}
+
+auto Editor::set(const std::string& section, const std::string& key, double value)
+    -> void
+{
+    char buffer[std::numeric_limits<double>::max_exponent10 + 32];
+    std::snprintf(buffer, sizeof buffer, "%f", value);
+    set(section, key, std::string(buffer));
+}
+
+auto Editor::remove_section(const std::string& section)
+    -> void
+{
+    auto headers = _headers.find(section);
+    if (headers == _headers.end())
+    {
+        throw editor_error(__FUNCTION__, _fname, "section '" + section + "' not found");
+    }
+
+    for (auto header: headers->second)
+    {
+        auto last = std::next(header);
+        while (last != _lines.end()
+               && last->kind != Kind::SECTION && last->kind != Kind::BROKEN)
+        {
+            ++last;
+        }
+        _lines.erase(header, last);
+    }
+    _headers.erase(headers);
+    _keys.erase(section);
+}
+
+auto Editor::remove_key(const std::string& section, const std::string& key)
+    -> void
+{
+    if (_headers.find(section) == _headers.end())
+    {
+        throw editor_error(__FUNCTION__, _fname, "section '" + section + "' not found");
+    }
+    auto& keys = _keys[section];
+    auto it = keys.find(key);
+    if (it == keys.end())
+    {
+        throw editor_error(__FUNCTION__, _fname, "key '" + key + "' not found");
+    }
+    _lines.erase(it->second);
+    keys.erase(it);
+}
+
+auto Editor::rename_section(const std::string& section, const std::string& new_section)
+    -> void
+{
+    auto headers = _headers.find(section);
+    if (headers == _headers.end())
+    {
+        throw editor_error(__FUNCTION__, _fname, "section '" + section + "' not found");
+    }
+    if (_headers.find(new_section) != _headers.end())
+    {
+        throw editor_error(__FUNCTION__, _fname, "section '" + new_section + "' already exists");
+    }
+
+    for (auto header: headers->second)
+    {
+        header->text.replace(header->name_first, header->name_last - header->name_first, new_section);
+        header->name_last = header->name_first + new_section.size();
+    }
+    _headers[new_section] = std::move(headers->second);
+    _headers.erase(section);
+    _keys[new_section] = std::move(_keys[section]);
+    _keys.erase(section);
+}
+
+auto Editor::rename_key(const std::string& section, const std::string& key,
+                        const std::string& new_key)
+    -> void
+{
+    if (_headers.find(section) == _headers.end())
+    {
+        throw editor_error(__FUNCTION__, _fname, "section '" + section + "' not found");
+    }
+    auto& keys = _keys[section];
+    auto it = keys.find(key);
+    if (it == keys.end())
+    {
+        throw editor_error(__FUNCTION__, _fname, "key '" + key + "' not found");
+    }
+    if (keys.find(new_key) != keys.end())
+    {
+        throw editor_error(__FUNCTION__, _fname, "key '" + new_key + "' already exists");
+    }
+
+    Line& line = *it->second;
+    line.text.replace(line.name_first, line.name_last - line.name_first, new_key);
+    std::size_t shift = line.name_first + new_key.size() - line.name_last;
+    line.name_last += shift;
+    line.value_first += shift;
+    line.value_last += shift;
+
+    auto pos = it->second;
+    keys.erase(it);
+    keys.emplace(new_key, pos);
+}
+
+auto Editor::commit()
+    -> void
+{
+    std::string contents = render();
+    std::lock_guard<std::mutex> lock(_mutex);
+    _contents = std::move(contents);
+    _pending = true;
+
+    // The clock may have started less than a delay
+    // ago, the first write is never deferred; a write
+    // that failed in the background is retried at once
+    if (_write_behind.count() == 0
+        || _last_write == std::chrono::steady_clock::time_point()
+        || _failed
+        || std::chrono::steady_clock::now() - _last_write >= _write_behind)
+    {
+        write_pending();
+        return;
+    }
+    _wake.notify_one();
+}
+
+auto Editor::flush()
+    -> void
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (not _pending)
+    {
+        return;
+    }
+    _contents = render();
+    write_pending();
+}
+
+auto Editor::set_write_behind(std::chrono::milliseconds delay)
+    -> void
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _write_behind = delay;
+    }
+    if (delay.count() > 0 && not _thread.joinable())
+    {
+        _thread = std::thread(&Editor::write_behind, this);
+    }
+    _wake.notify_one();
+}
+
+auto Editor::set_error_handler(std::function<void(const Error&)> handler)
+    -> void
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _error_handler = std::move(handler);
+}
+
+auto Editor::render() const
+    -> std::string
+{
+    std::string contents;
+    for (auto it = _lines.begin() ; it != _lines.end() ; ++it)
+    {
+        contents += it->text;
+        if (_final_terminator || std::next(it) != _lines.end())
+        {
+            contents += _dialect.lineterminator;
+        }
+    }
+    return contents;
+}
+
+auto Editor::write_pending()
+    -> void
+{
+    _failed = not replace_file(_fname, _contents);
+    if (_failed)
+    {
+        throw editor_error(__FUNCTION__, _fname, "can not write file");
+    }
+    _pending = false;
+    _contents.clear();
+    _last_write = std::chrono::steady_clock::now();
+}
+
+auto Editor::write_behind()
+    -> void
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (not _stopped)
+    {
+        // After a failure, the next commit retries
+        if (not _pending || _failed || _write_behind.count() == 0)
+        {
+            _wake.wait(lock);
+            continue;
+        }
+
+        auto deadline = _last_write + _write_behind;
+        if (std::chrono::steady_clock::now() < deadline)
+        {
+            _wake.wait_until(lock, deadline);
+            continue;
+        }
+
+        try
+        {
+            write_pending();
+        }
+        catch (const Error& error)
+        {
+            // Reported without the lock, so that a slow
+            // handler does not block the editor
+            auto handler = _error_handler;
+            lock.unlock();
+            if (handler)
+            {
+                handler(error);
+            }
+            lock.lock();
+        }
+    }
+}
+
+auto Editor::add_line(line_iterator pos, std::string text)
+    -> line_iterator
+{
+    LineInfo info = parse_line(text.data(), text.data() + text.size(), _dialect);
+    const std::size_t npos = std::string::npos;
+    Line line = { std::string(), Kind::OTHER, npos, npos, npos, npos };
+    switch (info.kind)
+    {
+        case LineKind::SECTION:
+            line.kind = Kind::SECTION;
+            break;
+        case LineKind::BROKEN:
+            line.kind = Kind::BROKEN;
+            break;
+        case LineKind::KEY:
+            line.kind = Kind::KEY;
+            line.value_first = info.value_first - text.data();
+            line.value_last = info.value_last - text.data();
+            break;
+        default:
+            break;
+    }
+    if (info.name_first != nullptr)
+    {
+        line.name_first = info.name_first - text.data();
+        line.name_last = info.name_last - text.data();
+    }
+    line.text = std::move(text);
+    return _lines.insert(pos, std::move(line));
+}
+
+
+////////////////////////////////////////////////////////////
+// Watcher
+////////////////////////////////////////////////////////////
+
+namespace
+{
+    // Modification time and size of a file,
+    // used when inotify is not available
+    auto file_state(const std::string& fname)
+        -> std::pair<long long, long long>
+    {
+        struct stat info;
+        if (::stat(fname.c_str(), &info) != 0)
+        {
+            return { -1, -1 };
+        }
+        return { static_cast<long long>(info.st_mtime),
+                 static_cast<long long>(info.st_size) };
+    }
+}
+
+Watcher::Watcher(const std::string& fname, Dialect dialect):
+    _fname(fname),
+    _dialect(dialect),
+    _snapshot(std::make_shared<const Document>(fname, dialect)),
+    _version(0),
+    _stopped(false),
+    _notify(-1)
+{
+    #ifdef POLDER_OS_LINUX
+        // The directory is watched instead of the file: an
+        // atomic write replaces the file by another one
+        _notify = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (_notify >= 0
+            && ::inotify_add_watch(_notify, split_path(fname).first.c_str(),
+                                   IN_CLOSE_WRITE | IN_MOVED_TO) < 0)
+        {
+            ::close(_notify);
+            _notify = -1;
+        }
+    #endif
+    _thread = std::thread(&Watcher::watch, this);
+}
+
+Watcher::~Watcher()
+{
+    _stopped = true;
+    _thread.join();
+    #ifdef POLDER_OS_LINUX
+        if (_notify >= 0)
+        {
+            ::close(_notify);
+        }
+    #endif
+}
+
+auto Watcher::snapshot() const
+    -> std::shared_ptr<const Document>
+{
+    return std::atomic_load(&_snapshot);
+}
+
+auto Watcher::version() const noexcept
+    -> std::size_t
+{
+    return _version.load(std::memory_order_acquire);
+}
+
+auto Watcher::reload()
+    -> bool
+{
+    std::lock_guard<std::mutex> lock(_reload_mutex);
+    std::shared_ptr<const Document> doc;
+    try
+    {
+        doc = std::make_shared<const Document>(_fname, _dialect);
+    }
+    catch (const Error&)
+    {
+        return false;
+    }
+    std::atomic_store(&_snapshot, std::move(doc));
+    _version.fetch_add(1, std::memory_order_release);
+    return true;
+}
+
+auto Watcher::watch()
+    -> void
+{
+    // The flag is checked at least every interval
+    const int interval = 100;
+    auto state = file_state(_fname);
+    while (not _stopped)
+    {
+        #ifdef POLDER_OS_LINUX
+            if (_notify >= 0)
+            {
+                pollfd fds = { _notify, POLLIN, 0 };
+                if (::poll(&fds, 1, interval) <= 0)
+                {
+                    continue;
+                }
+
+                // Several events for the file are merged
+                // into a single reload
+                const std::string name = split_path(_fname).second;
+                bool changed = false;
+                alignas(inotify_event) char buffer[4096];
+                ssize_t size;
+                while ((size = ::read(_notify, buffer, sizeof buffer)) > 0)
+                {
+                    for (const char* ptr = buffer ; ptr < buffer + size ; )
+                    {
+                        auto event = reinterpret_cast<const inotify_event*>(ptr);
+                        if (event->len > 0 && name == event->name)
+                        {
+                            changed = true;
+                        }
+                        ptr += sizeof(inotify_event) + event->len;
+                    }
+                }
+                if (changed)
+                {
+                    reload();
+                }
+                continue;
+            }
+        #endif
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(interval));
+        auto new_state = file_state(_fname);
+        if (new_state != state && reload())
+        {
+            state = new_state;
+        }
+    }
+}
+
+
+////////////////////////////////////////////////////////////
+// CachedDocument
+////////////////////////////////////////////////////////////
+
+/*
+ * The image is made of the header, the sections, the
+ * entries, the section table, the key table, then the
+ * strings; it only contains offsets, so it can be mapped
+ * anywhere. The hash tables are the ones of
+ * MappedDocument, holding indices + 1.
+ */
+struct CachedDocument::Header
+{
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t dialect;          // Characters used to parse the file
+    std::uint64_t source_size;
+    std::int64_t source_mtime;      // In nanoseconds
+    std::uint64_t source_hash;
+    std::uint64_t image_size;
+    std::uint32_t nb_sections;
+    std::uint32_t nb_entries;
+    std::uint32_t section_table_size;
+    std::uint32_t key_table_size;
+    std::uint64_t strings_size;
+};
+
+struct CachedDocument::SectionRecord
+{
+    std::uint32_t name;
+    std::uint32_t name_size;
+    std::uint32_t first;            // First entry of the section
+    std::uint32_t last;             // One past its last entry
+};
+
+struct CachedDocument::EntryRecord
+{
+    std::uint32_t section;
+    std::uint32_t key;
+    std::uint32_t key_size;
+    std::uint32_t value;
+    std::uint32_t value_size;
+};
+
+namespace
+{
+    const char image_magic[8] = { 'P', 'O', 'L', 'D', 'E', 'R', 'I', 'I' };
+    const std::uint32_t image_version = 1;
+
+    struct SourceInfo
+    {
+        std::uint64_t size;
+        std::int64_t mtime;
+        std::uint64_t hash;
+    };
+
+    auto dialect_signature(const Dialect& dialect)
+        -> std::uint32_t
+    {
+        return static_cast<unsigned char>(dialect.delimiter)
+             | static_cast<unsigned char>(dialect.commentchar) << 8
+             | static_cast<unsigned char>(dialect.lineterminator) << 16;
+    }
+
+    // Size and modification time of a file; the hash
+    // is only computed when they match the image
+    auto source_info(const std::string& fname)
+        -> SourceInfo
+    {
+        struct stat info;
+        if (::stat(fname.c_str(), &info) != 0)
+        {
+            throw Error("CachedDocument: " + fname + ": can not open file");
+        }
+        std::int64_t mtime = static_cast<std::int64_t>(info.st_mtime) * 1000000000;
+        #ifdef POLDER_OS_LINUX
+            mtime += info.st_mtim.tv_nsec;
+        #endif
+        return { static_cast<std::uint64_t>(info.st_size), mtime, 0 };
+    }
+
+    auto source_hash(const std::string& fname)
+        -> std::uint64_t
+    {
+        std::ifstream file(fname, std::ios::in | std::ios::binary);
+        std::uint64_t res = fnv_offset;
+        char buffer[1 << 16];
+        while (file.read(buffer, sizeof buffer) || file.gcount() > 0)
+        {
+            res = hash(StringView(buffer, file.gcount()), res);
+        }
+        return res;
+    }
+
+    template<typename T>
+    auto append(std::string& image, const T& value)
+        -> void
+    {
+        image.append(reinterpret_cast<const char*>(&value), sizeof value);
+    }
+}
+
+CachedDocument::CachedDocument(const std::string& fname, Dialect dialect):
+    _data(nullptr),
+    _size(0),
+    _from_image(false),
+    _header(nullptr),
+    _sections(nullptr),
+    _entries(nullptr),
+    _section_table(nullptr),
+    _key_table(nullptr),
+    _strings(nullptr)
+{
+    const std::string image_fname = fname + ".cache";
+    SourceInfo source = source_info(fname);
+
+    if (open_image(image_fname)
+        && _header->dialect == dialect_signature(dialect)
+        && _header->source_size == source.size
+        && _header->source_mtime == source.mtime
+        && _header->source_hash == source_hash(fname))
+    {
+        _from_image = true;
+        return;
+    }
+    release();
+
+    // Parse the file and build a new image
+    Document doc(fname, dialect);
+    source.hash = source_hash(fname);
+
+    const auto& section_names = doc.sections();
+    std::vector<SectionRecord> sections;
+    std::vector<EntryRecord> entries;
+    std::string strings;
+    auto add_string = [&](const std::string& str)
+    {
+        auto offset = strings.size();
+        strings += str;
+        return static_cast<std::uint32_t>(offset);
+    };
+
+    // The same keys are often found in many
+    // sections, they are only stored once
+    std::unordered_map<std::string, std::uint32_t> keys;
+    auto add_key = [&](const std::string& key)
+    {
+        auto it = keys.find(key);
+        if (it == keys.end())
+        {
+            it = keys.emplace(key, add_string(key)).first;
+        }
+        return it->second;
+    };
+
+    std::vector<std::uint32_t> section_table(table_size(section_names.size()), 0);
+    std::vector<std::uint32_t> key_table(table_size(doc.size()), 0);
+    for (std::size_t i = 0 ; i < section_names.size() ; ++i)
+    {
+        const std::string& name = section_names[i];
+        auto range = doc.section(name);
+        SectionRecord section = {
+            add_string(name),
+            static_cast<std::uint32_t>(name.size()),
+            static_cast<std::uint32_t>(entries.size()),
+            static_cast<std::uint32_t>(entries.size() + (range.second - range.first))
+        };
+        sections.push_back(section);
+        section_table[probe(section_table, hash(name), [](std::size_t) { return false; })] = i + 1;
+
+        for (auto it = range.first ; it != range.second ; ++it)
+        {
+            EntryRecord entry = {
+                static_cast<std::uint32_t>(i),
+                add_key(it->key),
+                static_cast<std::uint32_t>(it->key.size()),
+                add_string(it->value),
+                static_cast<std::uint32_t>(it->value.size())
+            };
+            entries.push_back(entry);
+            key_table[probe(key_table, hash(name, it->key), [](std::size_t) { return false; })]
+                = entries.size();
+        }
+    }
+    if (strings.size() > std::numeric_limits<std::uint32_t>::max())
+    {
+        throw Error("CachedDocument: " + fname + ": file too big to be cached");
+    }
+
+    Header header;
+    std::memcpy(header.magic, image_magic, sizeof image_magic);
+    header.version = image_version;
+    header.dialect = dialect_signature(dialect);
+    header.source_size = source.size;
+    header.source_mtime = source.mtime;
+    header.source_hash = source.hash;
+    header.nb_sections = sections.size();
+    header.nb_entries = entries.size();
+    header.section_table_size = section_table.size();
+    header.key_table_size = key_table.size();
+    header.strings_size = strings.size();
+    header.image_size = sizeof(Header)
+                      + sections.size() * sizeof(SectionRecord)
+                      + entries.size() * sizeof(EntryRecord)
+                      + (section_table.size() + key_table.size()) * sizeof(std::uint32_t)
+                      + strings.size();
+
+    std::string image;
+    image.reserve(header.image_size);
+    append(image, header);
+    for (const auto& section: sections)
+    {
+        append(image, section);
+    }
+    for (const auto& entry: entries)
+    {
+        append(image, entry);
+    }
+    image.append(reinterpret_cast<const char*>(section_table.data()),
+                 section_table.size() * sizeof(std::uint32_t));
+    image.append(reinterpret_cast<const char*>(key_table.data()),
+                 key_table.size() * sizeof(std::uint32_t));
+    image += strings;
+
+    // A directory that can not be written
+    // only prevents the next starts from
+    // using the image
+    replace_file(image_fname, image);
+    _buffer.assign(image.begin(), image.end());
+    _data = _buffer.data();
+    _size = _buffer.size();
+    load_image();
+}
+
+CachedDocument::CachedDocument(CachedDocument&& other) noexcept:
+    _data(other._data),
+    _size(other._size),
+    _buffer(std::move(other._buffer)),
+    _from_image(other._from_image),
+    _header(other._header),
+    _sections(other._sections),
+    _entries(other._entries),
+    _section_table(other._section_table),
+    _key_table(other._key_table),
+    _strings(other._strings)
+{
+    other._data = nullptr;
+    other._size = 0;
+}
+
+CachedDocument::~CachedDocument()
+{
+    release();
+}
+
+auto CachedDocument::operator=(CachedDocument&& other) noexcept
+    -> CachedDocument&
+{
+    // The old image is released with tmp
+    CachedDocument tmp(std::move(other));
+    std::swap(_data, tmp._data);
+    std::swap(_size, tmp._size);
+    _buffer.swap(tmp._buffer);
+    std::swap(_from_image, tmp._from_image);
+    std::swap(_header, tmp._header);
+    std::swap(_sections, tmp._sections);
+    std::swap(_entries, tmp._entries);
+    std::swap(_section_table, tmp._section_table);
+    std::swap(_key_table, tmp._key_table);
+    std::swap(_strings, tmp._strings);
+    return *this;
+}
+
+auto CachedDocument::open_image(const std::string& fname)
+    -> bool
+{
+    #ifndef POLDER_OS_WINDOWS
+        int fd = ::open(fname.c_str(), O_RDONLY);
+        if (fd == -1)
+        {
+            return false;
+        }
+        struct stat info;
+        if (::fstat(fd, &info) == 0 && info.st_size > 0)
+        {
+            void* addr = ::mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (addr != MAP_FAILED)
+            {
+                _data = static_cast<const char*>(addr);
+                _size = info.st_size;
+            }
+        }
+        ::close(fd);
+    #endif
+
+    if (_data == nullptr)
+    {
+        std::ifstream file(fname, std::ios::in | std::ios::binary);
+        if (not file)
+        {
+            return false;
+        }
+        _buffer.assign(std::istreambuf_iterator<char>(file),
+                       std::istreambuf_iterator<char>());
+        _data = _buffer.data();
+        _size = _buffer.size();
+    }
+    return load_image();
+}
+
+auto CachedDocument::load_image()
+    -> bool
+{
+    if (_size < sizeof(Header))
+    {
+        return false;
+    }
+    _header = reinterpret_cast<const Header*>(_data);
+    const Header& header = *_header;
+    if (std::memcmp(header.magic, image_magic, sizeof image_magic) != 0
+        || header.version != image_version
+        || header.image_size != _size
+        || header.section_table_size == 0
+        || (header.section_table_size & (header.section_table_size - 1)) != 0
+        || header.key_table_size == 0
+        || (header.key_table_size & (header.key_table_size - 1)) != 0
+        || header.section_table_size <= header.nb_sections
+        || header.key_table_size <= header.nb_entries)
+    {
+        return false;
+    }
+
+    std::uint64_t expected_size = sizeof(Header)
+                                + std::uint64_t(header.nb_sections) * sizeof(SectionRecord)
+                                + std::uint64_t(header.nb_entries) * sizeof(EntryRecord)
+                                + (std::uint64_t(header.section_table_size) + header.key_table_size)
+                                  * sizeof(std::uint32_t)
+                                + header.strings_size;
+    if (expected_size != _size)
+    {
+        return false;
+    }
+
+    const char* ptr = _data + sizeof(Header);
+    _sections = reinterpret_cast<const SectionRecord*>(ptr);
+    ptr += header.nb_sections * sizeof(SectionRecord);
+    _entries = reinterpret_cast<const EntryRecord*>(ptr);
+    ptr += header.nb_entries * sizeof(EntryRecord);
+    _section_table = reinterpret_cast<const std::uint32_t*>(ptr);
+    ptr += header.section_table_size * sizeof(std::uint32_t);
+    _key_table = reinterpret_cast<const std::uint32_t*>(ptr);
+    ptr += header.key_table_size * sizeof(std::uint32_t);
+    _strings = ptr;
+
+    // Checking the offsets is much cheaper than
+    // parsing and protects from damaged images
+    auto in_strings = [&](std::uint32_t offset, std::uint32_t size)
+    {
+        return std::uint64_t(offset) + size <= header.strings_size;
+    };
+    for (std::uint32_t i = 0 ; i < header.nb_sections ; ++i)
+    {
+        const SectionRecord& section = _sections[i];
+        if (not in_strings(section.name, section.name_size)
+            || section.first > section.last || section.last > header.nb_entries)
+        {
+            return false;
+        }
+    }
+    for (std::uint32_t i = 0 ; i < header.nb_entries ; ++i)
+    {
+        const EntryRecord& entry = _entries[i];
+        if (entry.section >= header.nb_sections
+            || not in_strings(entry.key, entry.key_size)
+            || not in_strings(entry.value, entry.value_size))
+        {
+            return false;
+        }
+    }
+
+    // Every element is in exactly one slot, so the tables
+    // are never full and the probing always ends
+    std::uint32_t nb_used = 0;
+    for (std::uint32_t i = 0 ; i < header.section_table_size ; ++i)
+    {
+        if (_section_table[i] > header.nb_sections)
+        {
+            return false;
+        }
+        nb_used += (_section_table[i] != 0);
+    }
+    if (nb_used != header.nb_sections)
+    {
+        return false;
+    }
+    nb_used = 0;
+    for (std::uint32_t i = 0 ; i < header.key_table_size ; ++i)
+    {
+        if (_key_table[i] > header.nb_entries)
+        {
+            return false;
+        }
+        nb_used += (_key_table[i] != 0);
+    }
+    return nb_used == header.nb_entries;
+}
+
+auto CachedDocument::release()
+    -> void
+{
+    #ifndef POLDER_OS_WINDOWS
+        if (_data != nullptr && _buffer.empty())
+        {
+            ::munmap(const_cast<char*>(_data), _size);
+        }
+    #endif
+    _buffer.clear();
+    _data = nullptr;
+    _size = 0;
+    _header = nullptr;
+}
+
+auto CachedDocument::string(std::uint32_t offset, std::uint32_t size) const
+    -> StringView
+{
+    return StringView(_strings + offset, size);
+}
+
+auto CachedDocument::from_image() const noexcept
+    -> bool
+{
+    return _from_image;
+}
+
+auto CachedDocument::section_exists(StringView section) const
+    -> bool
+{
+    auto slot = probe(_section_table, _header->section_table_size, hash(section),
+                      [&](std::size_t index)
+                      {
+                          const SectionRecord& record = _sections[index];
+                          return string(record.name, record.name_size) == section;
+                      });
+    return _section_table[slot] != 0;
+}
+
+auto CachedDocument::key_exists(StringView section, StringView key) const
+    -> bool
+{
+    return find(section, key).data() != nullptr;
+}
+
+auto CachedDocument::find(StringView section, StringView key) const
+    -> StringView
+{
+    auto slot = probe(_key_table, _header->key_table_size, hash(section, key),
+                      [&](std::size_t index)
+                      {
+                          const EntryRecord& entry = _entries[index];
+                          const SectionRecord& record = _sections[entry.section];
+                          return string(entry.key, entry.key_size) == key
+                              && string(record.name, record.name_size) == section;
+                      });
+    if (_key_table[slot] == 0)
+    {
+        return StringView();
+    }
+    const EntryRecord& entry = _entries[_key_table[slot] - 1];
+    // An empty value is not a null view
+    return StringView(_strings + entry.value, entry.value_size);
+}
+
+auto CachedDocument::read(StringView section, StringView key, StringView default_value) const
+    -> Element
+{
+    StringView value = find(section, key);
+    return std::string(value.data() ? value : default_value);
+}
+
+template<typename T>
+auto CachedDocument::get(StringView section, StringView key, const T& default_value) const
+    -> T
+{
+    StringView value = find(section, key);
+    return value.data() ? convert<T>(value.data(), value.data() + value.size()) : default_value;
+}
+
+#define X(type, func) \
+    template auto CachedDocument::get<type>(StringView, StringView, \
+                                            const type&) const -> type;
+#include <POLDER/details/ini.def>
+X(std::string, _)
+#undef X
+
+auto CachedDocument::sections() const
+    -> std::vector<StringView>
+{
+    std::vector<StringView> res;
+    res.reserve(_header->nb_sections);
+    for (std::uint32_t i = 0 ; i < _header->nb_sections ; ++i)
+    {
+        res.push_back(string(_sections[i].name, _sections[i].name_size));
+    }
+    return res;
+}
+
+auto CachedDocument::size() const
+    -> std::size_t
+{
+    return _header->nb_entries;
+}
+
+
+////////////////////////////////////////////////////////////
+// Functions
+////////////////////////////////////////////////////////////
+
+/**
+* Return whether the given section exists or not
+*/
+auto section_exists(const std::string& fname, const std::string& section, Dialect dialect)
+    -> bool
+{
+    return Document(fname, dialect).section_exists(section);
+}
+
+
+/**
+* Return whether the given key exists or not
+*/
+auto key_exists(const std::string& fname, const std::string& section, const std::string& key, Dialect dialect)
+    -> bool
+{
+    return Document(fname, dialect).key_exists(section, key);
+}
+
+
+/**
+* Read the string value corresponding to the given key
+*/
+auto read(const std::string& fname, const std::string& section, const std::string& key, const std::string& default_value, Dialect dialect)
+    -> Element
+{
+    return Document(fname, dialect).read(section, key, default_value);
+}
+
+
+/**
+* Reads several INI files as layers of one document
+*/
+auto load_layers(const std::vector<std::string>& fnames, Dialect dialect, std::size_t nb_threads)
+    -> Document
+{
+    if (nb_threads == 0)
+    {
+        nb_threads = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+    nb_threads = std::min(nb_threads, fnames.size());
+
+    // The threads take the next file to parse until
+    // there is none left or until one of them fails
+    std::vector<Document> layers(fnames.size());
+    std::atomic<std::size_t> next_file(0);
+    std::exception_ptr error;
+    std::mutex error_mutex;
+    auto work = [&]
+    {
+        for (auto i = next_file++ ; i < fnames.size() ; i = next_file++)
+        {
+            try
+            {
+                layers[i] = Document(fnames[i], dialect);
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(error_mutex);
+                if (not error)
+                {
+                    error = std::current_exception();
+                }
+                next_file = fnames.size();
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (std::size_t i = 1 ; i < nb_threads ; ++i)
+    {
+        threads.emplace_back(work);
+    }
+    work();
+    for (auto& thread: threads)
+    {
+        thread.join();
+    }
+
+    if (error)
+    {
+        std::rethrow_exception(error);
+    }
+    return Document::merge(layers);
+}
+
+
+/**
+* Deletes the given section of an INI file
+*/
+auto section_delete(const char* fname, const char* section, Dialect dialect)
+    -> void
+{
+    Editor editor(fname, dialect);
+    editor.remove_section(section);
+    editor.commit();
+}
+
+
+/**
+* Deletes the given key of an INI file
+*/
+auto key_delete(const char* fname, const char* section, const char* key, Dialect dialect)
+    -> void
+{
+    Editor editor(fname, dialect);
+    editor.remove_key(section, key);
+    editor.commit();
+}
+
+
+/**
+* Write a string in an INI file
+*/
+auto write(const char* fname, const char* section, const char* key, const char* value, Dialect dialect)
+    -> void
+{
+    Editor editor(fname, dialect);
+    editor.set(section, key, value);
+    editor.commit();
+}
+
+
+/**
+* Write a real in an INI file
+*/
+auto write(const char* fname, const char* section, const char* key, double value, Dialect dialect)
+    -> void
+{
+    Editor editor(fname, dialect);
+    editor.set(section, key, value);
+    editor.commit();
+}
+
+
+/**
+* Renames the given section of an INI file
+*/
+auto section_rename(const char* fname, const char* section, const char* new_section, Dialect dialect)
+    -> void
+{
+    Editor editor(fname, dialect);
+    editor.rename_section(section, new_section);
+    editor.commit();
+}
+
+
+/**
+* Renames the given key of an INI file
+*/
+auto key_rename(const char* fname, const char* section, const char* key, const char* new_key, Dialect dialect)
+    -> void
+{
+    Editor editor(fname, dialect);
+    editor.rename_key(section, key, new_key);
+    editor.commit();
 }
 
 
@@ -0,0 +1,469 @@
+/*
+ * Copyright (C) 2011-2014 Morwenn
+ *
+ * POLDER is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * POLDER is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program. If not,
+ * see <http://www.gnu.org/licenses/>.
+ */
+#include <cctype>
+#include <cmath>
+#include <cstddef>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <POLDER/evaluate.h>
+#include <POLDER/rational.h>
+
+using namespace polder;
+
+
+namespace
+{
+    // Identical results, NaN included
+    auto same(double lhs, double rhs)
+        -> bool
+    {
+        return (std::isnan(lhs) && std::isnan(rhs)) || lhs == rhs;
+    }
+
+    /**
+     * Random expressions over the variables x and y,
+     * using every kind of operator of the evaluator.
+     */
+    class expression_generator
+    {
+        public:
+
+            explicit expression_generator(unsigned seed):
+                _engine(seed)
+            {}
+
+            auto operator()(int depth)
+                -> std::string
+            {
+                if (depth == 0 || pick(4) == 0)
+                {
+                    return leaf();
+                }
+
+                static const char* const binary_operators[] = {
+                    "+", "-", "*", "/", "**", "<", ">", "=", "!=", "<=", ">=",
+                    "&&", "||", "^^", "<=>", "&", "|", "^"
+                };
+                static const char* const unary_functions[] = {
+                    "abs", "sqrt", "exp", "sin", "floor", "round", "sign"
+                };
+                static const char* const binary_functions[] = {
+                    "min", "max", "pow", "atan2", "hypot"
+                };
+
+                switch (pick(9))
+                {
+                    case 0:
+                        return "-(" + (*this)(depth-1) + ")";
+                    case 1:
+                        return "!(" + (*this)(depth-1) + ")";
+                    case 2:
+                        return "(" + (*this)(depth-1) + " ? " + (*this)(depth-1)
+                             + " : " + (*this)(depth-1) + ")";
+                    case 3:
+                        return std::string(unary_functions[pick(7)])
+                             + "(" + (*this)(depth-1) + ")";
+                    case 4:
+                        return std::string(binary_functions[pick(5)])
+                             + "(" + (*this)(depth-1) + ", " + (*this)(depth-1) + ")";
+                    case 5:
+                    {
+                        // Same subexpression twice
+                        std::string sub = (*this)(depth-1);
+                        return "((" + sub + ") * (" + sub + ") + " + sub + ")";
+                    }
+                    case 6:
+                        // Integer operators, sometimes by zero
+                        return "(" + (*this)(depth-1) + (pick(2) ? " % " : " // ")
+                             + std::to_string(pick(6)) + ")";
+                    default:
+                        return "(" + (*this)(depth-1) + " " + binary_operators[pick(18)]
+                             + " " + (*this)(depth-1) + ")";
+                }
+            }
+
+            // Value of a variable, exactly printable
+            auto value()
+                -> double
+            {
+                return (static_cast<int>(pick(33)) - 16) / 4.0;
+            }
+
+        private:
+
+            auto pick(unsigned n)
+                -> unsigned
+            {
+                return _engine() % n;
+            }
+
+            auto leaf()
+                -> std::string
+            {
+                switch (pick(5))
+                {
+                    case 0:     return "x";
+                    case 1:     return "y";
+                    case 2:     return std::to_string(pick(10));
+                    case 3:     return "0." + std::to_string(pick(100));
+                    default:    return std::to_string(pick(1000));
+                }
+            }
+
+            std::mt19937 _engine;
+    };
+
+    // Expression where the variables x and y are replaced
+    // by values, leaving the names of functions untouched
+    auto substitute(const std::string& expr, double x, double y)
+        -> std::string
+    {
+        std::ostringstream res;
+        for (std::size_t i = 0 ; i < expr.size() ; ++i)
+        {
+            char c = expr[i];
+            bool is_name = (c == 'x' || c == 'y')
+                && (i == 0 || not std::isalnum(expr[i-1]))
+                && (i+1 == expr.size() || not std::isalnum(expr[i+1]));
+            if (is_name)
+            {
+                res << '(' << (c == 'x' ? x : y) << ')';
+            }
+            else
+            {
+                res << c;
+            }
+        }
+        return res.str();
+    }
+}
+
+
+int main()
+{
+    ////////////////////////////////////////////////////////////
+    // Operators and functions
+    ////////////////////////////////////////////////////////////
+
+    POLDER_ASSERT(evaluate("1 + 2 * 3") == 7.0);
+    POLDER_ASSERT(evaluate("(1 + 2) * 3") == 9.0);
+    POLDER_ASSERT(evaluate("2 ** 10") == 1024.0);
+    POLDER_ASSERT(evaluate("-3 ** 2") == 9.0);
+    POLDER_ASSERT(evaluate("7 // 2 + 7 % 2") == 4.0);
+    POLDER_ASSERT(evaluate("3!") == 6.0);
+    POLDER_ASSERT(evaluate("1 <=> 2") == -1.0);
+    POLDER_ASSERT(evaluate("0 && 1 / 0") == 0.0);
+    POLDER_ASSERT(evaluate("1 ? 2 : 3 ? 4 : 5") == 2.0);
+    POLDER_ASSERT(evaluate("max(2, sqrt(16))") == 4.0);
+    POLDER_ASSERT(evaluate("hypot(3, 4) = 5") == 1.0);
+
+    // The operands that are not needed are not computed,
+    // even when they are constants
+    POLDER_ASSERT(evaluate("0 && 1 % 0") == 0.0);
+    POLDER_ASSERT(evaluate("1 || 1 // 0") == 1.0);
+    POLDER_ASSERT(evaluate("1 ? 2 : 1000000000000!") == 2.0);
+    POLDER_ASSERT(compile("x && 1 % 0")({ 0.0 }) == 0.0);
+
+    ////////////////////////////////////////////////////////////
+    // Errors
+    ////////////////////////////////////////////////////////////
+
+    const char* const invalid_expressions[] = {
+        "", "1 +", "(1", "1)", "2 3", "1 : 2", "1 ? 2", "foo(1)",
+        "max(1)", "sqrt()", "x + 1", "1 $ 2"
+    };
+    for (const char* expr: invalid_expressions)
+    {
+        bool thrown = false;
+        try
+        {
+            evaluate(expr);
+        }
+        catch (const evaluation_error&)
+        {
+            thrown = true;
+        }
+        POLDER_ASSERT(thrown);
+    }
+
+    // Deep nesting is an error, not a stack overflow
+    {
+        const std::string nested_expressions[] = {
+            std::string(100000, '(') + "1" + std::string(100000, ')'),
+            std::string(100000, '-') + "1",
+            std::string(100000, '!') + "1",
+        };
+        for (const auto& expr: nested_expressions)
+        {
+            bool thrown = false;
+            try
+            {
+                evaluate(expr);
+            }
+            catch (const evaluation_error&)
+            {
+                thrown = true;
+            }
+            POLDER_ASSERT(thrown);
+        }
+
+        // Long chains are not nested
+        std::string sum = "x";
+        for (int i = 0 ; i < 100000 ; ++i)
+        {
+            sum += " + x";
+        }
+        POLDER_ASSERT(compile(sum)({ 0.5 }) == 50000.5);
+    }
+
+    ////////////////////////////////////////////////////////////
+    // Compiled expressions
+    ////////////////////////////////////////////////////////////
+
+    {
+        auto expr = compile("x * x + y");
+        POLDER_ASSERT(expr.variables().size() == 2);
+        POLDER_ASSERT(expr({ 3.0, 1.0 }) == 10.0);
+
+        // Empty expression
+        {
+            expression empty;
+            int nb_thrown = 0;
+            try { empty(); } catch (const evaluation_error&) { ++nb_thrown; }
+            try { empty({ 1.0 }); } catch (const evaluation_error&) { ++nb_thrown; }
+            try { double result; empty.evaluate_batch(nullptr, 1, &result); } catch (const evaluation_error&) { ++nb_thrown; }
+            POLDER_ASSERT(nb_thrown == 3);
+        }
+
+        auto ordered = compile("x * x + y", { "y", "x" });
+        POLDER_ASSERT(ordered.slot("x") == 1);
+        POLDER_ASSERT(ordered({ 1.0, 3.0 }) == 10.0);
+
+        const double xs[] = { 1.0, 2.0, 3.0 };
+        const double ys[] = { 0.5, 0.5, 0.5 };
+        const double* columns[] = { xs, ys };
+        double out[3];
+        expr.evaluate_batch(columns, 3, out);
+        POLDER_ASSERT(out[0] == 1.5 && out[1] == 4.5 && out[2] == 9.5);
+
+        // Both branches are computed, even the division by zero
+        auto modulo = compile("x ? 10 % x + 10 // x : -1");
+        const double divisors[] = { 0.0, 3.0, 4.0 };
+        const double* modulo_columns[] = { divisors };
+        modulo.evaluate_batch(modulo_columns, 3, out);
+        POLDER_ASSERT(out[0] == -1.0 && out[1] == 4.0 && out[2] == 4.0);
+        POLDER_ASSERT(std::isnan(compile("x % 0")({ 5.0 })));
+        POLDER_ASSERT(std::isnan(compile("x // y")({ 1e10, 2.0 })));
+
+        // Same for the other operations that are not defined
+        // for every number, computed in every row
+        const double values[] = { -1.0, 2.5, 1e10, 3.0, 200.0 };
+        const double* value_columns[] = { values };
+        const char* const guarded_expressions[] = {
+            "x >= 0 ? x! : 0",
+            "x >= 0 && x < 32 ? (1 << x) + (1 >> x) : 0",
+            "x < 100 ? (x & 6) + (x | 1) + (x ^ 3) + ~x : 0",
+        };
+        for (const char* expr: guarded_expressions)
+        {
+            double results[5];
+            auto guarded = compile(expr);
+            guarded.evaluate_batch(value_columns, 5, results);
+            for (std::size_t row = 0 ; row < 5 ; ++row)
+            {
+                POLDER_ASSERT(same(results[row], guarded({ values[row] })));
+            }
+        }
+        POLDER_ASSERT(std::isnan(compile("x!")({ 2.5 })));
+        POLDER_ASSERT(std::isnan(compile("x!")({ 171.0 })));
+        POLDER_ASSERT(compile("x!")({ 20.0 }) == 2432902008176640000.0);
+        POLDER_ASSERT(std::isnan(compile("1 << x")({ 32.0 })));
+        POLDER_ASSERT(std::isnan(compile("x & 1")({ 1e10 })));
+        POLDER_ASSERT(std::isnan(compile("~x")({ -1e10 })));
+    }
+
+    ////////////////////////////////////////////////////////////
+    // Exact evaluation
+    ////////////////////////////////////////////////////////////
+
+    POLDER_ASSERT(evaluate<long long>("9007199254740993 + 2") == 9007199254740995LL);
+    POLDER_ASSERT(evaluate<long long>("7 / 2") == 3);
+    {
+        auto res = evaluate<rational<long long>>("1/3 + 1/6");
+        POLDER_ASSERT(res.numerator() == 1 && res.denominator() == 2);
+    }
+
+    // Overflows are errors
+    POLDER_ASSERT(evaluate<long long>("0 - 9223372036854775807 - 1") == std::numeric_limits<long long>::min());
+    POLDER_ASSERT(evaluate<long long>("20!") == 2432902008176640000LL);
+    POLDER_ASSERT(evaluate<long long>("3 ** 39 + (1 << 62)") == 4052555153018976267LL + (1LL << 62));
+    {
+        const char* const overflowing_expressions[] = {
+            "9223372036854775807 + 1",
+            "0 - 9223372036854775807 - 2",
+            "3037000500 * 3037000500",
+            "3 ** 100",
+            "25!",
+            "100000000000000!",
+            "1 << 70",
+            "1 << -1",
+            "1 >> 64",
+            "3 << 62",
+            "(0 - 9223372036854775807 - 1) // (0 - 1)",
+            "(0 - 9223372036854775807 - 1) % (0 - 1)",
+            "-(0 - 9223372036854775807 - 1)",
+        };
+        for (const char* expr: overflowing_expressions)
+        {
+            bool thrown = false;
+            try
+            {
+                evaluate<long long>(expr);
+            }
+            catch (const evaluation_error&)
+            {
+                thrown = true;
+            }
+            POLDER_ASSERT(thrown);
+        }
+
+        bool thrown = false;
+        try
+        {
+            evaluate<rational<long long>>("1/9223372036854775807 + 1/9223372036854775806");
+        }
+        catch (const evaluation_error&)
+        {
+            thrown = true;
+        }
+        POLDER_ASSERT(thrown);
+    }
+
+    ////////////////////////////////////////////////////////////
+    // Compile-time evaluation
+    ////////////////////////////////////////////////////////////
+
+    static_assert(meta::evaluate("(1 + 2) ** 3 / 4") == 6.75, "");
+    static_assert(meta::evaluate("1 ? 2 : 3 ? 4 : 5") == 2.0, "");
+    static_assert(meta::evaluate("5! <=> 100") == 1.0, "");
+    static_assert(meta::evaluate<long long>("7 / 2 + 2 ** 40") == 3 + (1LL << 40), "");
+    static_assert(meta::evaluate<long long>("0 && 1 / 0") == 0, "");
+    POLDER_ASSERT(meta::evaluate("0.1 + 0.2") == evaluate("0.1 + 0.2"));
+    static_assert(meta::evaluate<long long>("20!") == 2432902008176640000LL, "");
+    static_assert(meta::evaluate<long long>("-(2 ** 62) * 2") == std::numeric_limits<long long>::min(), "");
+
+    // Same results as the runtime evaluator
+    {
+        const char* const expressions[] = {
+            "1 // 0", "1 % 0", "7 // -2", "-7 % 3", "3000000000 // 2",
+            "-2147483648 // -1", "3000000000 & 1", "-1 | 6", "5 ^ 3",
+            "~3000000000", "~-6", "1 << 31", "-1 << 3", "1 << 32", "1 << -1",
+            "-16 >> 2", "5 >> 40", "0!", "5!", "170!", "171!", "2.5!", "(0-1)!",
+        };
+        for (const char* expr: expressions)
+        {
+            double lhs = meta::evaluate(expr);
+            double rhs = evaluate(expr);
+            POLDER_ASSERT((std::isnan(lhs) && std::isnan(rhs)) || lhs == rhs);
+        }
+
+        const char* const integer_expressions[] = {
+            "20!", "21!", "(0-1)!", "9223372036854775807 + 1", "-9223372036854775807 - 2",
+            "3037000500 * 3037000500", "-(2 ** 62) * 2", "-(2 ** 62) * 2 * -1",
+            "-(-(2 ** 62) * 2)", "(-(2 ** 62) * 2) / -1", "(-(2 ** 62) * 2) % -1",
+            "7 / 0", "7 % 0", "2 ** 63", "(0-2) ** 63", "3 ** 40", "2 ** -1",
+            "1 << 62", "1 << 63", "-1 << 63", "-2 << 62", "1 << 64", "1 << -1",
+            "-256 >> 4", "1 >> 64", "7 // 2", "~5 & 12 | 1 ^ 3",
+        };
+        for (const char* expr: integer_expressions)
+        {
+            long long lhs = 0, rhs = 0;
+            std::string lhs_error, rhs_error;
+            try { lhs = meta::evaluate<long long>(expr); }
+            catch (const std::exception& exc) { lhs_error = exc.what(); }
+            try { rhs = evaluate<long long>(expr); }
+            catch (const std::exception& exc) { rhs_error = exc.what(); }
+            POLDER_ASSERT(lhs == rhs && lhs_error == rhs_error);
+        }
+    }
+
+    ////////////////////////////////////////////////////////////
+    // Fuzzing: every evaluation mode gives the same results
+    ////////////////////////////////////////////////////////////
+
+    {
+        expression_generator generate(42);
+        const std::size_t nb_rows = 300;
+        std::size_t nb_mismatches = 0;
+
+        for (int i = 0 ; i < 2000 ; ++i)
+        {
+            std::string expr = generate(5);
+            auto compiled = compile(expr, { "x", "y" });
+
+            std::vector<double> xs, ys;
+            for (std::size_t row = 0 ; row < nb_rows ; ++row)
+            {
+                xs.push_back(generate.value());
+                ys.push_back(generate.value());
+            }
+            const double* columns[] = { xs.data(), ys.data() };
+            std::vector<double> batch(nb_rows);
+            compiled.evaluate_batch(columns, nb_rows, batch.data());
+
+            for (std::size_t row = 0 ; row < nb_rows ; ++row)
+            {
+                double compiled_res = compiled({ xs[row], ys[row] });
+                if (not same(compiled_res, batch[row]))
+                {
+                    std::cerr << "batch mismatch: " << expr << '\n';
+                    ++nb_mismatches;
+                }
+            }
+
+            // The textual modes are slower, only
+            // check them on a few rows
+            for (std::size_t row = 0 ; row < 3 ; ++row)
+            {
+                std::string text = substitute(expr, xs[row], ys[row]);
+                double compiled_res = compiled({ xs[row], ys[row] });
+
+                set_expression_cache_capacity(0);
+                double one_shot = evaluate(text);
+                set_expression_cache_capacity(1 << 20);
+                double cache_miss = evaluate(text);
+                double cache_hit = evaluate(text);
+
+                if (not same(compiled_res, one_shot)
+                    || not same(compiled_res, cache_miss)
+                    || not same(compiled_res, cache_hit))
+                {
+                    std::cerr << "mismatch: " << text << '\n';
+                    ++nb_mismatches;
+                }
+            }
+        }
+        POLDER_ASSERT(nb_mismatches == 0);
+    }
+
+    return 0;
+}
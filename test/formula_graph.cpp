@@ -0,0 +1,189 @@
+/*
+ * Copyright (C) 2011-2014 Morwenn
+ *
+ * POLDER is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * POLDER is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program. If not,
+ * see <http://www.gnu.org/licenses/>.
+ */
+#include <cmath>
+#include <cstddef>
+#include <random>
+#include <string>
+#include <vector>
+#include <POLDER/formula_graph.h>
+
+using namespace polder;
+
+
+namespace
+{
+    // Name of the k-th formula of the given chain
+    auto name(std::size_t chain, std::size_t k)
+        -> std::string
+    {
+        return "f" + std::to_string(chain) + "_" + std::to_string(k);
+    }
+}
+
+
+int main()
+{
+    ////////////////////////////////////////////////////////////
+    // Propagation
+    ////////////////////////////////////////////////////////////
+
+    {
+        formula_graph graph;
+        graph.set("a", 2.0);
+        graph.set("b", 3.0);
+        graph.define("c", "a * b");
+        graph.define("d", "c + 1");
+        graph.define("e", "b * 10");
+        POLDER_ASSERT(graph.value("d") == 7.0);
+        POLDER_ASSERT(graph.value("e") == 30.0);
+
+        // Only the formulas depending on a change
+        graph.set("a", 4.0);
+        POLDER_ASSERT(graph.value("c") == 12.0);
+        POLDER_ASSERT(graph.value("d") == 13.0);
+        POLDER_ASSERT(graph.value("e") == 30.0);
+
+        // Redefinitions change the dependencies
+        graph.define("c", "b - 1");
+        POLDER_ASSERT(graph.value("d") == 3.0);
+        graph.set("a", 100.0);
+        POLDER_ASSERT(graph.value("d") == 3.0);
+
+        // A formula turned into an input
+        graph.set("c", 41.0);
+        graph.set("b", 0.0);
+        POLDER_ASSERT(graph.value("d") == 42.0);
+
+        // Names never set are NaN
+        graph.define("f", "g + 1");
+        POLDER_ASSERT(graph.contains("g"));
+        POLDER_ASSERT(std::isnan(graph.value("f")));
+        POLDER_ASSERT(not graph.contains("h"));
+    }
+
+    // An input set then redefined is only recomputed once,
+    // and its dependents are computed after their inputs
+    for (std::size_t nb_threads: { 1, 4 })
+    {
+        formula_graph graph(nb_threads);
+        graph.set("b", 1.0);
+        graph.set("a", 0.0);
+        graph.define("f", "b + 1");
+        graph.define("e", "f + 1");
+        graph.define("c", "a + e");
+        POLDER_ASSERT(graph.value("c") == 3.0);
+
+        graph.set("a", 5.0);
+        graph.define("a", "3");
+        graph.set("b", 10.0);
+        POLDER_ASSERT(graph.value("c") == 15.0);
+    }
+
+    ////////////////////////////////////////////////////////////
+    // Cycles
+    ////////////////////////////////////////////////////////////
+
+    {
+        formula_graph graph;
+        graph.set("x", 1.0);
+        graph.define("a", "x + 1");
+        graph.define("b", "a * 2");
+        graph.define("c", "b + a");
+
+        const char* const cycles[][2] = {
+            { "a", "a + 1" },
+            { "a", "c - 1" },
+            { "a", "x + b" },
+            { "x", "c" },
+        };
+        for (const auto& cycle: cycles)
+        {
+            bool thrown = false;
+            try
+            {
+                graph.define(cycle[0], cycle[1]);
+            }
+            catch (const evaluation_error&)
+            {
+                thrown = true;
+            }
+            POLDER_ASSERT(thrown);
+
+            // Nothing changed
+            graph.set("x", graph.value("x") + 1.0);
+            double x = graph.value("x");
+            POLDER_ASSERT(graph.value("a") == x + 1.0);
+            POLDER_ASSERT(graph.value("b") == 2.0 * (x + 1.0));
+            POLDER_ASSERT(graph.value("c") == 3.0 * (x + 1.0));
+        }
+    }
+
+    ////////////////////////////////////////////////////////////
+    // Threads: same results as a single thread
+    ////////////////////////////////////////////////////////////
+
+    {
+        const std::size_t nb_chains = 64;
+        const std::size_t chain_size = 20;
+        std::mt19937 engine(5);
+
+        formula_graph single(1);
+        formula_graph multi(4);
+        for (std::size_t chain = 0 ; chain < nb_chains ; ++chain)
+        {
+            for (std::size_t k = 1 ; k < chain_size ; ++k)
+            {
+                // Mostly independent chains, with a few
+                // links merging some of them
+                std::string expr = name(chain, k-1) + " * 0.5 + " + std::to_string(k);
+                if (engine() % 16 == 0 && chain > 0)
+                {
+                    expr += " + " + name(engine() % chain, engine() % chain_size);
+                }
+                single.define(name(chain, k), expr);
+                multi.define(name(chain, k), expr);
+            }
+        }
+
+        for (int round = 0 ; round < 20 ; ++round)
+        {
+            // Change a few inputs at once
+            for (int i = 0 ; i < 8 ; ++i)
+            {
+                auto chain = engine() % nb_chains;
+                double value = static_cast<int>(engine() % 1000) - 500;
+                single.set(name(chain, 0), value);
+                multi.set(name(chain, 0), value);
+            }
+            single.recalculate();
+            multi.recalculate();
+
+            for (std::size_t chain = 0 ; chain < nb_chains ; ++chain)
+            {
+                for (std::size_t k = 0 ; k < chain_size ; ++k)
+                {
+                    double lhs = single.value(name(chain, k));
+                    double rhs = multi.value(name(chain, k));
+                    POLDER_ASSERT((std::isnan(lhs) && std::isnan(rhs)) || lhs == rhs);
+                }
+            }
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,585 @@
+/*
+ * Copyright (C) 2011-2014 Morwenn
+ *
+ * POLDER is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * POLDER is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program. If not,
+ * see <http://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <POLDER/ini.h>
+
+#ifndef POLDER_OS_WINDOWS
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+using namespace polder;
+
+
+int main()
+{
+    const char* fname = "polder_test.ini";
+    {
+        std::ofstream file(fname);
+        file << "; Configuration file\n"
+             << "orphan = 0\n"
+             << "[window]\n"
+             << "  width = 800   \n"
+             << "height=600 ; pixels\n"
+             << "title = My window\n"
+             << "\n"
+             << "[ratio] ; section comment\n"
+             << "value = 1.5\n"
+             << "[window]\n"
+             << "width = 1024\n"
+             << "fullscreen = 1\n";
+    }
+
+    ////////////////////////////////////////////////////////////
+    // Document
+    ////////////////////////////////////////////////////////////
+
+    {
+        ini::Document doc(fname);
+
+        POLDER_ASSERT(doc.section_exists("window"));
+        POLDER_ASSERT(doc.section_exists("ratio"));
+        POLDER_ASSERT(not doc.section_exists("sound"));
+
+        POLDER_ASSERT(doc.key_exists("window", "width"));
+        POLDER_ASSERT(not doc.key_exists("window", "value"));
+        POLDER_ASSERT(not doc.key_exists("ratio", "orphan"));
+
+        POLDER_ASSERT(doc.get<int>("window", "width", 0) == 800);
+        POLDER_ASSERT(doc.get<int>("window", "height", 0) == 600);
+        POLDER_ASSERT(doc.get<int>("window", "depth", 32) == 32);
+        POLDER_ASSERT(doc.get<double>("ratio", "value", 0.0) == 1.5);
+        POLDER_ASSERT(doc.get<std::string>("window", "title", "") == "My window");
+        POLDER_ASSERT(std::string(doc.read("sound", "volume", "high")) == "high");
+
+        // Sections in order, duplicated ones merged
+        POLDER_ASSERT(doc.sections().size() == 2);
+        POLDER_ASSERT(doc.sections()[0] == "window");
+        POLDER_ASSERT(doc.size() == 5);
+
+        auto window = doc.section("window");
+        POLDER_ASSERT(window.second - window.first == 4);
+        POLDER_ASSERT(window.first->key == "width");
+        POLDER_ASSERT((window.second - 1)->key == "fullscreen");
+        POLDER_ASSERT(doc.begin()->section == "window");
+
+        // Cached conversions, of the same type or not
+        POLDER_ASSERT(doc.get<double>("ratio", "value", 0.0) == 1.5);
+        POLDER_ASSERT(doc.get<float>("ratio", "value", 0.0f) == 1.5f);
+        POLDER_ASSERT(doc.get<int>("ratio", "value", 0) == 1);
+        ini::Document copy = doc;
+        POLDER_ASSERT(copy.get<double>("ratio", "value", 0.0) == 1.5);
+    }
+
+    ////////////////////////////////////////////////////////////
+    // Layers
+    ////////////////////////////////////////////////////////////
+
+    {
+        const char* const layer_names[] = {
+            "polder_test_0.ini", "polder_test_1.ini", "polder_test_2.ini"
+        };
+        std::ofstream(layer_names[0]) << "[a]\nx = 0\ny = 0\n[b]\nz = 0\n";
+        std::ofstream(layer_names[1]) << "[b]\nz = 1\nw = 1\n";
+        std::ofstream(layer_names[2]) << "[c]\nv = 2\n[a]\ny = 2\n";
+
+        std::vector<std::string> fnames(std::begin(layer_names), std::end(layer_names));
+        ini::Document doc = ini::load_layers(fnames, {}, 2);
+        POLDER_ASSERT(doc.size() == 5);
+        POLDER_ASSERT(doc.sections().size() == 3);
+        POLDER_ASSERT(doc.sections()[2] == "c");
+        POLDER_ASSERT(doc.get<int>("a", "x", -1) == 0);
+        POLDER_ASSERT(doc.get<int>("a", "y", -1) == 2);
+        POLDER_ASSERT(doc.get<int>("b", "z", -1) == 1);
+        POLDER_ASSERT(doc.section("b").first[1].key == "w");
+
+        fnames.push_back("polder_test_missing.ini");
+        bool thrown = false;
+        try
+        {
+            ini::load_layers(fnames);
+        }
+        catch (const ini::Error&)
+        {
+            thrown = true;
+        }
+        POLDER_ASSERT(thrown);
+
+        for (const char* name: layer_names)
+        {
+            std::remove(name);
+        }
+    }
+
+    ////////////////////////////////////////////////////////////
+    // Dialects
+    ////////////////////////////////////////////////////////////
+
+    {
+        // The common dialects have their own scanner, which
+        // has to give the same results as the generic one
+        const char* const dialect_names[] = { "polder_test_fixed.ini", "polder_test_runtime.ini" };
+        const char alphabet[] = "ab  =;[]\n\n\r\t";
+        const char presets[][2] = { { '=', ';' }, { '=', '#' }, { ':', ';' }, { ':', '#' } };
+        std::mt19937 engine(7);
+
+        auto entries = [](const char* name, ini::Dialect dialect)
+        {
+            std::string res;
+            ini::StreamReader reader(name, dialect, 16);
+            while (reader.next())
+            {
+                res += std::string(reader.section()) + '|' + std::string(reader.key())
+                     + '|' + std::string(reader.value()) + '\n';
+            }
+            auto doc = ini::Document(name, dialect);
+            for (const auto& entry: doc)
+            {
+                res += entry.section + '|' + entry.key + '|' + entry.value + '\n';
+            }
+            return res;
+        };
+
+        for (int i = 0 ; i < 400 ; ++i)
+        {
+            std::string text(engine() % 300, ' ');
+            for (char& c: text)
+            {
+                c = alphabet[engine() % (sizeof alphabet - 1)];
+            }
+            const char* preset = presets[i % 4];
+
+            ini::Dialect fixed, runtime;
+            fixed.delimiter = preset[0];
+            fixed.commentchar = preset[1];
+            runtime.delimiter = '~';
+            runtime.commentchar = '!';
+
+            std::string fixed_text = text, runtime_text = text;
+            std::replace(fixed_text.begin(), fixed_text.end(), '=', fixed.delimiter);
+            std::replace(fixed_text.begin(), fixed_text.end(), ';', fixed.commentchar);
+            std::replace(runtime_text.begin(), runtime_text.end(), '=', runtime.delimiter);
+            std::replace(runtime_text.begin(), runtime_text.end(), ';', runtime.commentchar);
+            std::ofstream(dialect_names[0], std::ios::binary) << fixed_text;
+            std::ofstream(dialect_names[1], std::ios::binary) << runtime_text;
+
+            // Sections are found the same way when they are parsed lazily
+            std::string doc_res, lazy_res;
+            ini::Document doc(dialect_names[0], fixed);
+            for (const auto& entry: doc)
+            {
+                doc_res += entry.section + '|' + entry.key + '|' + entry.value + '\n';
+            }
+            ini::LazyDocument lazy(dialect_names[0], fixed);
+            for (auto section: lazy.sections())
+            {
+                auto keys = lazy.section(section);
+                for (auto it = keys.first ; it != keys.second ; ++it)
+                {
+                    lazy_res += std::string(it->section) + '|' + std::string(it->key)
+                              + '|' + std::string(it->value) + '\n';
+                }
+            }
+            POLDER_ASSERT(doc_res == lazy_res);
+
+            std::string fixed_res = entries(dialect_names[0], fixed);
+            std::string runtime_res = entries(dialect_names[1], runtime);
+            std::replace(runtime_res.begin(), runtime_res.end(), runtime.delimiter, fixed.delimiter);
+            std::replace(runtime_res.begin(), runtime_res.end(), runtime.commentchar, fixed.commentchar);
+            POLDER_ASSERT(fixed_res == runtime_res);
+        }
+
+        for (const char* name: dialect_names)
+        {
+            std::remove(name);
+        }
+    }
+
+    ////////////////////////////////////////////////////////////
+    // Number parsing
+    ////////////////////////////////////////////////////////////
+
+    POLDER_ASSERT(int(ini::Element(" -2147483648")) == -2147483647 - 1);
+    POLDER_ASSERT(unsigned(ini::Element("4294967295")) == 4294967295u);
+    POLDER_ASSERT(double(ini::Element("0.1")) == 0.1);
+    POLDER_ASSERT(double(ini::Element("-12.5e-3 ; comment")) == -12.5e-3);
+    POLDER_ASSERT(double(ini::Element("123456789012345678901234567890")) == 123456789012345678901234567890.0);
+    POLDER_ASSERT(float(ini::Element("3.4028235e38")) == 3.4028235e38f);
+    {
+        bool thrown = false;
+        try
+        {
+            (void) int(ini::Element("2147483648"));
+        }
+        catch (const std::out_of_range&)
+        {
+            thrown = true;
+        }
+        POLDER_ASSERT(thrown);
+    }
+
+    ////////////////////////////////////////////////////////////
+    // MappedDocument
+    ////////////////////////////////////////////////////////////
+
+    {
+        ini::Document doc(fname);
+        ini::MappedDocument mapped(fname);
+
+        POLDER_ASSERT(mapped.size() == doc.size());
+        POLDER_ASSERT(mapped.sections().size() == doc.sections().size());
+        auto it = mapped.begin();
+        for (const auto& entry: doc)
+        {
+            POLDER_ASSERT(it->section == entry.section);
+            POLDER_ASSERT(it->key == entry.key);
+            POLDER_ASSERT(it->value == entry.value);
+            ++it;
+        }
+
+        POLDER_ASSERT(mapped.section_exists("ratio"));
+        POLDER_ASSERT(not mapped.key_exists("ratio", "width"));
+        POLDER_ASSERT(mapped.read("window", "title", "") == "My window");
+        POLDER_ASSERT(mapped.get<int>("window", "width", 0) == 800);
+        POLDER_ASSERT(mapped.get<int>("window", "depth", 32) == 32);
+
+        auto window = mapped.section("window");
+        POLDER_ASSERT(window.second - window.first == 4);
+
+        ini::MappedDocument moved(std::move(mapped));
+        POLDER_ASSERT(moved.get<double>("ratio", "value", 0.0) == 1.5);
+    }
+
+    ////////////////////////////////////////////////////////////
+    // LazyDocument
+    ////////////////////////////////////////////////////////////
+
+    {
+        ini::LazyDocument doc(fname);
+        POLDER_ASSERT(doc.sections().size() == 2);
+        POLDER_ASSERT(doc.section_exists("ratio"));
+        POLDER_ASSERT(not doc.key_exists("ratio", "width"));
+
+        // Every thread parses the sections it needs
+        std::vector<std::thread> threads;
+        std::atomic<int> nb_errors(0);
+        for (int i = 0 ; i < 4 ; ++i)
+        {
+            threads.emplace_back([&]
+            {
+                if (doc.get<int>("window", "width", 0) != 800
+                    || doc.read("window", "title", "") != "My window"
+                    || doc.get<double>("ratio", "value", 0.0) != 1.5)
+                {
+                    ++nb_errors;
+                }
+            });
+        }
+        for (auto& thread: threads)
+        {
+            thread.join();
+        }
+        POLDER_ASSERT(nb_errors == 0);
+
+        auto window = doc.section("window");
+        POLDER_ASSERT(window.second - window.first == 4);
+        auto sound = doc.section("sound");
+        POLDER_ASSERT(sound.first == sound.second);
+
+        ini::LazyDocument moved(std::move(doc));
+        POLDER_ASSERT(moved.get<int>("window", "depth", 32) == 32);
+    }
+
+    {
+        const char* empty_name = "polder_test_empty.ini";
+        std::ofstream(empty_name).close();
+        ini::LazyDocument empty(empty_name);
+        POLDER_ASSERT(empty.sections().empty());
+        POLDER_ASSERT(not empty.key_exists("window", "width"));
+        std::remove(empty_name);
+    }
+
+    ////////////////////////////////////////////////////////////
+    // CachedDocument
+    ////////////////////////////////////////////////////////////
+
+    {
+        const std::string image_name = std::string(fname) + ".cache";
+        std::remove(image_name.c_str());
+
+        ini::CachedDocument built(fname);
+        POLDER_ASSERT(not built.from_image());
+        ini::CachedDocument doc(fname);
+        POLDER_ASSERT(doc.from_image());
+
+        POLDER_ASSERT(doc.size() == 5);
+        POLDER_ASSERT(doc.sections().size() == 2);
+        POLDER_ASSERT(doc.section_exists("ratio"));
+        POLDER_ASSERT(not doc.key_exists("ratio", "orphan"));
+        POLDER_ASSERT(doc.get<int>("window", "width", 0) == 800);
+        POLDER_ASSERT(doc.get<std::string>("window", "title", "") == "My window");
+        POLDER_ASSERT(doc.get<double>("ratio", "value", 0.0) == 1.5);
+        POLDER_ASSERT(std::string(doc.read("sound", "volume", "high")) == "high");
+
+        // A damaged image is rebuilt
+        {
+            std::fstream image(image_name, std::ios::in | std::ios::out | std::ios::binary);
+            image.seekp(-1, std::ios::end);
+            image.put('\0');
+            image.put('\0');
+        }
+        POLDER_ASSERT(not ini::CachedDocument(fname).from_image());
+        POLDER_ASSERT(ini::CachedDocument(fname).from_image());
+
+        // A key table without empty slot would make
+        // the lookups of missing keys loop forever
+        {
+            std::fstream image(image_name, std::ios::in | std::ios::out | std::ios::binary);
+            std::uint32_t key_table_size;
+            std::uint64_t image_size, strings_size;
+            image.seekg(40);
+            image.read(reinterpret_cast<char*>(&image_size), sizeof image_size);
+            image.seekg(60);
+            image.read(reinterpret_cast<char*>(&key_table_size), sizeof key_table_size);
+            image.read(reinterpret_cast<char*>(&strings_size), sizeof strings_size);
+            image.seekp(image_size - strings_size - key_table_size * sizeof(std::uint32_t));
+            const std::uint32_t first_entry = 1;
+            for (std::uint32_t i = 0 ; i < key_table_size ; ++i)
+            {
+                image.write(reinterpret_cast<const char*>(&first_entry), sizeof first_entry);
+            }
+        }
+        {
+            ini::CachedDocument damaged(fname);
+            POLDER_ASSERT(not damaged.from_image());
+            POLDER_ASSERT(not damaged.key_exists("window", "missing"));
+        }
+        std::remove(image_name.c_str());
+    }
+
+    ////////////////////////////////////////////////////////////
+    // StreamReader
+    ////////////////////////////////////////////////////////////
+
+    {
+        // Tiny buffer, refilled and grown many times
+        ini::StreamReader reader(fname, {}, 4);
+        std::string res;
+        while (reader.next())
+        {
+            res += std::string(reader.section()) + '.' + std::string(reader.key())
+                 + '=' + std::string(reader.value()) + '|';
+        }
+        POLDER_ASSERT(res == "window.width=800|window.height=600|window.title=My window|"
+                             "ratio.value=1.5|window.width=1024|window.fullscreen=1|");
+        POLDER_ASSERT(not reader.next());
+    }
+
+    ////////////////////////////////////////////////////////////
+    // Free functions
+    ////////////////////////////////////////////////////////////
+
+    POLDER_ASSERT(ini::section_exists(fname, "ratio"));
+    POLDER_ASSERT(ini::key_exists(fname, "window", "title"));
+    POLDER_ASSERT(float(ini::read(fname, "ratio", "value", "0")) == 1.5f);
+
+    ////////////////////////////////////////////////////////////
+    // Editor
+    ////////////////////////////////////////////////////////////
+
+    {
+        ini::Editor editor(fname);
+        editor.set("window", "height", "768");
+        editor.set("window", "depth", "32");
+        editor.set("sound", "volume", 0.5);
+        editor.remove_key("window", "title");
+        editor.rename_section("ratio", "aspect");
+        editor.rename_key("aspect", "value", "ratio");
+        editor.commit();
+
+        std::ifstream file(fname);
+        std::string contents((std::istreambuf_iterator<char>(file)),
+                             std::istreambuf_iterator<char>());
+        POLDER_ASSERT(contents ==
+            "; Configuration file\n"
+            "orphan = 0\n"
+            "[window]\n"
+            "  width = 800   \n"
+            "height=768 ; pixels\n"
+            "depth=32\n"
+            "\n"
+            "[aspect] ; section comment\n"
+            "ratio = 1.5\n"
+            "[window]\n"
+            "width = 1024\n"
+            "fullscreen = 1\n"
+            "\n"
+            "[sound]\n"
+            "volume=0.500000\n");
+
+        ini::section_delete(fname, "window");
+        ini::Document doc(fname);
+        POLDER_ASSERT(not doc.section_exists("window"));
+        POLDER_ASSERT(doc.get<double>("aspect", "ratio", 0.0) == 1.5);
+        POLDER_ASSERT(doc.get<double>("sound", "volume", 0.0) == 0.5);
+
+        bool thrown = false;
+        try
+        {
+            ini::Editor(fname).remove_key("sound", "title");
+        }
+        catch (const ini::Error&)
+        {
+            thrown = true;
+        }
+        POLDER_ASSERT(thrown);
+    }
+
+    {
+        // Only the first commit of a burst is written at once
+        ini::Editor editor(fname);
+        editor.set_write_behind(std::chrono::hours(1));
+        editor.set("sound", "volume", "1");
+        editor.commit();
+        POLDER_ASSERT(ini::Document(fname).get<int>("sound", "volume", 0) == 1);
+        editor.set("sound", "volume", "2");
+        editor.commit();
+        POLDER_ASSERT(ini::Document(fname).get<int>("sound", "volume", 0) == 1);
+        editor.flush();
+        POLDER_ASSERT(ini::Document(fname).get<int>("sound", "volume", 0) == 2);
+    }
+
+    {
+        // The deferred commits are written once the delay expires
+        const char* delayed_fname = "polder_test_delayed.ini";
+        {
+            ini::Editor editor(delayed_fname);
+            editor.set_write_behind(std::chrono::milliseconds(50));
+            editor.set("sound", "volume", "1");
+            editor.commit();
+            editor.set("sound", "volume", "2");
+            editor.commit();
+            POLDER_ASSERT(ini::Document(delayed_fname).get<int>("sound", "volume", 0) == 1);
+            std::this_thread::sleep_for(std::chrono::milliseconds(500));
+            POLDER_ASSERT(ini::Document(delayed_fname).get<int>("sound", "volume", 0) == 2);
+        }
+        std::remove(delayed_fname);
+    }
+
+#ifndef POLDER_OS_WINDOWS
+    {
+        // The writes that can not throw report their errors
+        const char* dir_name = "polder_test_dir";
+        const std::string dir_fname = std::string(dir_name) + "/editor.ini";
+        POLDER_ASSERT(::mkdir(dir_name, 0777) == 0);
+        std::atomic<int> nb_errors(0);
+        {
+            ini::Editor editor(dir_fname);
+            editor.set_write_behind(std::chrono::milliseconds(50));
+            editor.set_error_handler([&](const ini::Error&) { ++nb_errors; });
+            editor.set("sound", "volume", "1");
+            editor.commit();
+            editor.set("sound", "volume", "2");
+            editor.commit();
+
+            // The background write fails
+            POLDER_ASSERT(std::remove(dir_fname.c_str()) == 0);
+            POLDER_ASSERT(::rmdir(dir_name) == 0);
+            std::this_thread::sleep_for(std::chrono::milliseconds(500));
+            POLDER_ASSERT(nb_errors == 1);
+
+            // The next commit writes at once
+            bool thrown = false;
+            try
+            {
+                editor.commit();
+            }
+            catch (const ini::Error&)
+            {
+                thrown = true;
+            }
+            POLDER_ASSERT(thrown);
+        }
+        // The destructor fails too
+        POLDER_ASSERT(nb_errors == 2);
+    }
+#endif
+
+#ifndef POLDER_OS_WINDOWS
+    {
+        // A new file gets the mode allowed by the umask,
+        // a replaced file keeps its mode
+        const char* new_fname = "polder_test_mode.ini";
+        std::remove(new_fname);
+        mode_t mask = ::umask(022);
+        {
+            ini::Editor editor(new_fname);
+            editor.set("sound", "volume", "1");
+            editor.commit();
+        }
+        struct stat info;
+        POLDER_ASSERT(::stat(new_fname, &info) == 0 && (info.st_mode & 07777) == 0644);
+
+        POLDER_ASSERT(::chmod(new_fname, 0600) == 0);
+        {
+            ini::Editor editor(new_fname);
+            editor.set("sound", "volume", "2");
+            editor.commit();
+        }
+        POLDER_ASSERT(::stat(new_fname, &info) == 0 && (info.st_mode & 07777) == 0600);
+        ::umask(mask);
+        std::remove(new_fname);
+    }
+#endif
+
+    ////////////////////////////////////////////////////////////
+    // Watcher
+    ////////////////////////////////////////////////////////////
+
+    {
+        ini::Watcher watcher(fname);
+        auto doc = watcher.snapshot();
+        POLDER_ASSERT(doc->get<int>("sound", "volume", 0) == 2);
+
+        ini::write(fname, "sound", "volume", "3");
+        for (int i = 0 ; i < 500 && watcher.version() == 0 ; ++i)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        POLDER_ASSERT(watcher.version() > 0);
+        POLDER_ASSERT(watcher.snapshot()->get<int>("sound", "volume", 0) == 3);
+
+        // The old snapshot is left untouched
+        POLDER_ASSERT(doc->get<int>("sound", "volume", 0) == 2);
+    }
+
+    std::remove(fname);
+    return 0;
+}
@@ -292,4 +292,60 @@ int main()
         POLDER_ASSERT(make_rational(-1, 12) * c == d);
         POLDER_ASSERT(inverse(a) == d);
     }
+
+    // TEST: out-parameter functions
+    // - resize
+    // - add_into/subtract_into
+    // - multiply_into/divide_into
+    // - transpose_into
+    // - inverse_into
+    {
+        Matrix<int> a = {
+            { 1, 3, 2 },
+            { 5, 7, 4 }
+        };
+        Matrix<int> b = {
+            { 4, -2 },
+            { 1, 0 },
+            { -1, 4 }
+        };
+
+        Matrix<int> out;
+        multiply_into(out, a, b);
+        POLDER_ASSERT(out == a*b);
+
+        // Same shape: the memory is reused
+        const int* addr = out.data();
+        multiply_into(out, a, b);
+        POLDER_ASSERT(out.data() == addr);
+        POLDER_ASSERT(out == a*b);
+
+        transpose_into(out, a);
+        POLDER_ASSERT(out == transpose(a));
+        add_into(out, out, b);
+        POLDER_ASSERT(out == transpose(a) + b);
+        subtract_into(out, out, b);
+        multiply_into(out, out, 2);
+        divide_into(out, out, 2);
+        POLDER_ASSERT(out == transpose(a));
+
+        out.resize(4, 5);
+        POLDER_ASSERT(out.height() == 4);
+        POLDER_ASSERT(out.width() == 5);
+        POLDER_ASSERT(out.size() == 20);
+
+        Matrix<rational<int>> c = {
+            { 1, 2, -1 },
+            { -2, 1, 1 },
+            { 0, 3, -3 }
+        };
+        Matrix<rational<int>> d;
+        inverse_into(d, c);
+        POLDER_ASSERT(d == inverse(c));
+
+        Matrix<rational<int>> e;
+        divide_into(e, c, c);
+        POLDER_ASSERT(e == c * inverse(c));
+        POLDER_ASSERT(e == c / c);
+    }
 }